@@ -13,6 +13,8 @@ if [ "$#" == 1 ]; then
         target="unit_tests"
     elif [ "$1" == "--solvitaire" ]; then
         target="solvitaire"
+    elif [ "$1" == "--library" ]; then
+        target="libsolvitaire libsolvitaire-static"
     else
         error=true
     fi
@@ -31,6 +33,8 @@ if [ "$#" == 2 ]; then
         target="unit_tests"
     elif [ "$2" == "--solvitaire" ]; then
         target="solvitaire"
+    elif [ "$2" == "--library" ]; then
+        target="libsolvitaire libsolvitaire-static"
     else
         error=true
     fi
@@ -41,14 +45,14 @@ if [ "$#" -gt 2 ]; then
 fi
 
 if [ "$error" = true ]; then
-    echo "Usage: ./build.sh [--release|--debug] [--solvitaire|--unit-tests]"
+    echo "Usage: ./build.sh [--release|--debug] [--solvitaire|--unit-tests|--library]"
     echo "(default args = --release --solvitaire)"
     exit 1
 else
     cmake [-G "CodeBlocks - Unix Makefiles"] \
     "-DCMAKE_BUILD_TYPE=${build^^}" \
     "-Bcmake-build-$build" -H. 
-    cmake --build "cmake-build-$build" -- "$target"
+    cmake --build "cmake-build-$build" -- $target
     exit 0
 fi
 
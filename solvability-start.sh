@@ -28,7 +28,7 @@ echo "CL: $0 $@" >> "$out.experiment"
 echo "Host: $HOSTNAME: " >> "$out.experiment"
 echo "StartDate: " `date` >> "$out.experiment"
 
-echo "Attempted Seed, Outcome, Time Taken(ms), States Searched, Unique States Searched, Backtracks, Dominance Moves, States Removed From Cache, Final States In Cache, Final Buckets In Cache, Maximum Search Depth, Final Search Depth, real (time), user (time), sys (time) " >> "$out.experiment"
+echo "Attempted Seed, Outcome, Time Taken(ms), Teardown Time(ms), States Searched, Unique States Searched, Backtracks, Dominance Moves, States Removed From Cache, Final States In Cache, Final Buckets In Cache, Final Cache Bytes, Peak Cache Bytes, Maximum Search Depth, Final Search Depth, real (time), user (time), sys (time) " >> "$out.experiment"
 
 cat $out | parallel --joblog $out.log --memfree $minramfree -j"$cores" "exec $time_command $sol_command --ra {} --class 2>&1 | $combine_command >> $out.csv"
 
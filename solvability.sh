@@ -15,7 +15,7 @@ out="$4"
 time_command="/usr/bin/time -f \" %e, %U, %S\""
 combine_command="sed -e 'H;\${x;s/\n/,/g;s/^,//;p;};d'"
 
-echo "Attempted Seed, Outcome, Time Taken(ms), States Searched, Unique States Searched, Backtracks, Dominance Moves, States Removed From Cache, Final States In Cache, Final Buckets In Cache, Maximum Search Depth, Final Search Depth, real (time), user (time), sys (time) " > "$out.csv"
+echo "Attempted Seed, Outcome, Time Taken(ms), Teardown Time(ms), States Searched, Unique States Searched, Backtracks, Dominance Moves, States Removed From Cache, Final States In Cache, Final Buckets In Cache, Final Cache Bytes, Peak Cache Bytes, Maximum Search Depth, Final Search Depth, real (time), user (time), sys (time) " > "$out.csv"
 
 seq "$seeds" | parallel --joblog $out.log --progress --memfree $minramfree -j"$cores" "exec $time_command $sol_command --ra {} --class 2>&1 | $combine_command >> $out.csv"
 
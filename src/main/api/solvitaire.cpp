@@ -0,0 +1,362 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "solvitaire.h"
+#include "../version.h"
+#include "../../../lib/rapidjson/document.h"
+#include "../game/move.h"
+#include "../game/sol_rules.h"
+#include "../game/global_cache.h"
+#include "../game/search-state/game_state.h"
+#include "../solver/solver.h"
+#include "../input-output/input/sol_preset_types.h"
+#include "../input-output/input/json-parsing/rules_parser.h"
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using boost::optional;
+using rapidjson::Document;
+
+typedef std::chrono::milliseconds millisec;
+typedef game_state::streamliner_options sos;
+typedef game_state::pile_kind pk;
+
+struct solvitaire_rules {
+    sol_rules rules;
+};
+
+struct solvitaire_deal {
+    sol_rules rules;
+    optional<int> seed;
+    std::unique_ptr<Document> doc;
+};
+
+struct solvitaire_solver {
+    solvitaire_solver(const game_state&, const cache_options&, uint, optional<millisec>, uint64_t);
+
+    solver sol;
+    const optional<millisec> timeout;
+    const uint64_t state_limit;
+    search_budget budget; // Only ever cancelled. The limits are set when the solver is run
+    bool has_run;
+    vector<move> solution;
+};
+
+solvitaire_solver::solvitaire_solver(const game_state& gs, const cache_options& cache_opts,
+                                     uint threads, optional<millisec> timeout_, uint64_t state_limit_)
+        : sol(gs, cache_opts, threads)
+        , timeout(timeout_)
+        , state_limit(state_limit_)
+        , budget()
+        , has_run(false)
+        , solution() {
+}
+
+////////////
+// Errors //
+////////////
+
+static thread_local string last_error;
+
+// Makes an API call, so that no exception escapes into the caller. If one is
+// thrown its message is kept, and the value for failure returned instead
+template<class R, class F>
+static R guard(R on_failure, F call) {
+    try {
+        return call();
+    } catch (const std::exception& e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "unknown error";
+    }
+    return on_failure;
+}
+
+static void require(const void* arg, const char* name) {
+    if (!arg) throw runtime_error(string("no ") + name + " given");
+}
+
+const char* solvitaire_version(void) {
+    return SOLVITAIRE_VERSION_H;
+}
+
+const char* solvitaire_last_error(void) {
+    return last_error.c_str();
+}
+
+///////////
+// Rules //
+///////////
+
+solvitaire_rules* solvitaire_rules_from_preset(const char* type) {
+    return guard<solvitaire_rules*>(nullptr, [&] {
+        require(type, "game type");
+        if (!sol_preset_types::is_valid_preset(type))
+            throw runtime_error(string("solitaire type is not valid: ") + type);
+        return new solvitaire_rules{rules_parser::from_preset(type)};
+    });
+}
+
+solvitaire_rules* solvitaire_rules_from_json(const char* json) {
+    return guard<solvitaire_rules*>(nullptr, [&] {
+        require(json, "rules");
+        return new solvitaire_rules{rules_parser::from_json(json)};
+    });
+}
+
+void solvitaire_rules_free(solvitaire_rules* r) {
+    delete r;
+}
+
+///////////
+// Deals //
+///////////
+
+solvitaire_deal* solvitaire_deal_from_seed(const solvitaire_rules* r, int seed) {
+    return guard<solvitaire_deal*>(nullptr, [&] {
+        require(r, "rules");
+        return new solvitaire_deal{r->rules, seed, nullptr};
+    });
+}
+
+solvitaire_deal* solvitaire_deal_from_json(const solvitaire_rules* r, const char* json) {
+    return guard<solvitaire_deal*>(nullptr, [&] {
+        require(r, "rules");
+        require(json, "deal");
+
+        std::unique_ptr<Document> doc(new Document);
+        doc->Parse(json);
+        if (doc->HasParseError()) throw runtime_error("deal not valid json");
+
+        // Dealt once here, so that a deal that doesn't fit the rules is
+        // rejected now rather than when it is solved
+        game_state(r->rules, *doc, sos::NONE);
+        return new solvitaire_deal{r->rules, boost::none, std::move(doc)};
+    });
+}
+
+void solvitaire_deal_free(solvitaire_deal* d) {
+    delete d;
+}
+
+/////////////
+// Solving //
+/////////////
+
+void solvitaire_options_init(solvitaire_options* opts) {
+    const cache_options cache_opts;
+    opts->timeout_ms = 0;
+    opts->cache_capacity = cache_opts.capacity;
+    opts->cache_memory = cache_opts.memory;
+    opts->threads = 1;
+    opts->streamliners = SOLVITAIRE_STREAMLINERS_NONE;
+    opts->state_limit = 0;
+}
+
+static sos to_streamliner_options(solvitaire_streamliners s) {
+    switch (s) {
+        case SOLVITAIRE_STREAMLINERS_NONE:             return sos::NONE;
+        case SOLVITAIRE_STREAMLINERS_AUTO_FOUNDATIONS: return sos::AUTO_FOUNDATIONS;
+        case SOLVITAIRE_STREAMLINERS_SUIT_SYMMETRY:    return sos::SUIT_SYMMETRY;
+        case SOLVITAIRE_STREAMLINERS_BOTH:             return sos::BOTH;
+    }
+    throw runtime_error("streamliners are not valid");
+}
+
+solvitaire_solver* solvitaire_solver_create(const solvitaire_deal* d, const solvitaire_options* opts) {
+    return guard<solvitaire_solver*>(nullptr, [&] {
+        require(d, "deal");
+        solvitaire_options o;
+        solvitaire_options_init(&o);
+        if (opts) o = *opts;
+
+        const sos str_opts = to_streamliner_options(o.streamliners);
+        const game_state gs = d->seed ? game_state(d->rules, *d->seed, str_opts)
+                                      : game_state(d->rules, *d->doc, str_opts);
+
+        cache_options cache_opts(o.cache_capacity);
+        cache_opts.memory = o.cache_memory;
+
+        optional<millisec> timeout;
+        if (o.timeout_ms > 0) timeout = millisec(o.timeout_ms);
+
+        return new solvitaire_solver(gs, cache_opts, std::max(o.threads, 1u), timeout, o.state_limit);
+    });
+}
+
+static solvitaire_outcome to_outcome(solver::result::type t) {
+    switch (t) {
+        case solver::result::type::TIMEOUT:    return SOLVITAIRE_TIMEOUT;
+        case solver::result::type::SOLVED:     return SOLVITAIRE_SOLVED;
+        case solver::result::type::UNSOLVABLE: return SOLVITAIRE_UNSOLVABLE;
+        case solver::result::type::MEM_LIMIT:  return SOLVITAIRE_MEM_LIMIT;
+        case solver::result::type::TERMINATED: return SOLVITAIRE_CANCELLED;
+    }
+    assert(false);
+    return SOLVITAIRE_CANCELLED;
+}
+
+int solvitaire_solver_run(solvitaire_solver* s, solvitaire_result* out) {
+    return guard(-1, [&] {
+        require(s, "solver");
+        require(out, "result");
+        if (s->has_run) throw runtime_error("the solver has already been run");
+        s->has_run = true;
+
+        // The timeout runs from here, and cancelling the solver cancels the run
+        search_budget budget(s->timeout, &s->budget);
+        if (s->state_limit > 0) budget.set_state_limit(s->state_limit);
+        const solver::result res = s->sol.run(budget);
+        s->solution = s->sol.get_solution();
+        // Only the solution is needed from here on, and the cache can be large
+        s->sol.release_cache();
+
+        out->outcome = to_outcome(res.sol_type);
+        out->time_ms = uint64_t(res.time.count());
+        out->states_searched = res.states_searched;
+        out->unique_states_searched = res.unique_states_searched;
+        out->backtracks = res.backtracks;
+        out->dominance_moves = res.dominance_moves;
+        out->states_removed_from_cache = res.states_removed_from_cache;
+        out->final_states_in_cache = res.cache_size;
+        out->peak_cache_bytes = res.peak_cache_bytes;
+        out->max_search_depth = res.max_depth;
+        out->solution_length = s->solution.size();
+        return 0;
+    });
+}
+
+void solvitaire_solver_cancel(solvitaire_solver* s) {
+    if (s) s->budget.cancel();
+}
+
+static solvitaire_pile_kind to_pile_kind(pk k) {
+    switch (k) {
+        case pk::HOLE:       return SOLVITAIRE_PILE_HOLE;
+        case pk::FOUNDATION: return SOLVITAIRE_PILE_FOUNDATION;
+        case pk::CELL:       return SOLVITAIRE_PILE_CELL;
+        case pk::STOCK:      return SOLVITAIRE_PILE_STOCK;
+        case pk::WASTE:      return SOLVITAIRE_PILE_WASTE;
+        case pk::RESERVE:    return SOLVITAIRE_PILE_RESERVE;
+        case pk::ACCORDION:  return SOLVITAIRE_PILE_ACCORDION;
+        case pk::TABLEAU:    return SOLVITAIRE_PILE_TABLEAU;
+        case pk::SEQUENCE:   return SOLVITAIRE_PILE_SEQUENCE;
+    }
+    assert(false);
+    return SOLVITAIRE_PILE_TABLEAU;
+}
+
+static solvitaire_pile to_pile(const game_state& gs, pile::ref pr, uint8_t position = 0) {
+    const std::pair<pk, uint8_t> loc = gs.locate_pile(pr);
+    return solvitaire_pile{to_pile_kind(loc.first), loc.second, position};
+}
+
+static solvitaire_move_type to_move_type(move::mtype t) {
+    switch (t) {
+        case move::mtype::regular:              return SOLVITAIRE_MOVE_REGULAR;
+        case move::mtype::built_group:          return SOLVITAIRE_MOVE_BUILT_GROUP;
+        case move::mtype::stock_k_plus:         return SOLVITAIRE_MOVE_STOCK_K_PLUS;
+        case move::mtype::stock_to_all_tableau: return SOLVITAIRE_MOVE_STOCK_TO_ALL_TABLEAU;
+        case move::mtype::sequence:             return SOLVITAIRE_MOVE_SEQUENCE;
+        case move::mtype::accordion:            return SOLVITAIRE_MOVE_ACCORDION;
+        case move::mtype::null:                 break;
+    }
+    throw runtime_error("solution holds an unknown move");
+}
+
+// Describes a move in terms of the deal's piles, then makes it, so that the
+// card it moves can be read off the state
+static solvitaire_move to_api_move(game_state& gs, const move& m) {
+    solvitaire_move am;
+    am.type = to_move_type(m.type);
+    am.count = m.count;
+    am.reveals_card = m.reveal_move;
+
+    // Sequence moves give the positions of cards among all of the sequences
+    pile::ref from = m.from, to = m.to;
+    uint8_t from_pos = 0, to_pos = 0;
+    if (m.type == move::mtype::sequence) {
+        std::tie(from, from_pos) = gs.locate_sequence_card(m.from);
+        std::tie(to, to_pos) = gs.locate_sequence_card(m.to);
+    }
+
+    // Dealing to the tableau doesn't name its piles
+    if (m.type == move::mtype::stock_to_all_tableau) {
+        am.from = solvitaire_pile{SOLVITAIRE_PILE_STOCK, 0, 0};
+        am.to = solvitaire_pile{SOLVITAIRE_PILE_TABLEAU, 0, 0};
+    } else {
+        am.from = to_pile(gs, from, from_pos);
+        am.to = to_pile(gs, to, to_pos);
+    }
+
+    gs.make_move(m);
+
+    string c;
+    const vector<pile>& piles = gs.get_data();
+    switch (m.type) {
+        case move::mtype::regular:
+        case move::mtype::stock_k_plus:
+            c = piles[to][0].to_string();
+            break;
+        case move::mtype::built_group:
+        case move::mtype::accordion:
+            c = piles[to][pile::size_type(m.count - 1)].to_string();
+            break;
+        case move::mtype::sequence:
+            c = piles[to][to_pos].to_string();
+            break;
+        default:
+            break;
+    }
+    std::strncpy(am.card, c.c_str(), sizeof(am.card) - 1);
+    am.card[sizeof(am.card) - 1] = '\0';
+    return am;
+}
+
+size_t solvitaire_solver_solution(const solvitaire_solver* s, solvitaire_move* moves, size_t max_moves) {
+    return guard<size_t>(0, [&] {
+        require(s, "solver");
+        if (max_moves > 0) require(moves, "moves");
+
+        game_state gs(s->sol.init_state);
+        for (size_t i = 0; i < s->solution.size() && i < max_moves; i++) {
+            moves[i] = to_api_move(gs, s->solution[i]);
+        }
+        return s->solution.size();
+    });
+}
+
+void solvitaire_solver_free(solvitaire_solver* s) {
+    delete s;
+}
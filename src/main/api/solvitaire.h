@@ -0,0 +1,169 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_API_H
+#define SOLVITAIRE_API_H
+
+// The interface to libsolvitaire, for programs that solve deals in-process
+// rather than running the solvitaire executable. It is plain C so that it
+// can be called from any language, and only grows: existing functions and
+// the fields of existing structs keep their meaning from one version to the
+// next.
+//
+// Functions that create an object return NULL, and those that do something
+// return non-zero, when they fail. solvitaire_last_error() then says why.
+// Objects may be used from any thread, but only from one at a time, except
+// for solvitaire_solver_cancel(), which is meant to be called while another
+// thread runs the solver.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The only symbols the shared library exports
+#define SOLVITAIRE_API __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct solvitaire_rules solvitaire_rules;
+typedef struct solvitaire_deal solvitaire_deal;
+typedef struct solvitaire_solver solvitaire_solver;
+
+typedef enum {
+    SOLVITAIRE_STREAMLINERS_NONE,
+    SOLVITAIRE_STREAMLINERS_AUTO_FOUNDATIONS,
+    SOLVITAIRE_STREAMLINERS_SUIT_SYMMETRY,
+    SOLVITAIRE_STREAMLINERS_BOTH
+} solvitaire_streamliners;
+
+typedef struct {
+    uint64_t timeout_ms;        // Zero for none
+    uint64_t cache_capacity;    // The most states the cache holds
+    uint64_t cache_memory;      // An upper bound on the bytes used by the cache, or zero for none
+    uint32_t threads;           // The threads that search the deal together
+    solvitaire_streamliners streamliners;
+    uint64_t state_limit;       // The most states searched before timing out, or zero for none
+} solvitaire_options;
+
+typedef enum {
+    SOLVITAIRE_TIMEOUT,
+    SOLVITAIRE_SOLVED,
+    SOLVITAIRE_UNSOLVABLE,
+    SOLVITAIRE_MEM_LIMIT,
+    SOLVITAIRE_CANCELLED
+} solvitaire_outcome;
+
+typedef struct {
+    solvitaire_outcome outcome;
+    uint64_t time_ms;
+    uint64_t states_searched;
+    uint64_t unique_states_searched;
+    uint64_t backtracks;
+    uint64_t dominance_moves;
+    uint64_t states_removed_from_cache;
+    uint64_t final_states_in_cache;
+    uint64_t peak_cache_bytes;
+    uint64_t max_search_depth;
+    uint64_t solution_length;   // Zero unless solved
+} solvitaire_result;
+
+typedef enum {
+    SOLVITAIRE_PILE_HOLE,
+    SOLVITAIRE_PILE_FOUNDATION,
+    SOLVITAIRE_PILE_CELL,
+    SOLVITAIRE_PILE_STOCK,
+    SOLVITAIRE_PILE_WASTE,
+    SOLVITAIRE_PILE_RESERVE,
+    SOLVITAIRE_PILE_ACCORDION,
+    SOLVITAIRE_PILE_TABLEAU,
+    SOLVITAIRE_PILE_SEQUENCE
+} solvitaire_pile_kind;
+
+// A pile, by its position among the piles of its kind in the deal. For
+// sequences, also the position of the card within the sequence
+typedef struct {
+    solvitaire_pile_kind kind;
+    uint8_t index;
+    uint8_t position;
+} solvitaire_pile;
+
+typedef enum {
+    SOLVITAIRE_MOVE_REGULAR,              // The top card of one pile onto another
+    SOLVITAIRE_MOVE_BUILT_GROUP,          // The top count cards of one pile onto another
+    SOLVITAIRE_MOVE_STOCK_K_PLUS,         // Count cards from the stock to the waste (or back, if negative), then the waste card onto a pile
+    SOLVITAIRE_MOVE_STOCK_TO_ALL_TABLEAU, // A card from the stock onto each of the first count tableau piles
+    SOLVITAIRE_MOVE_SEQUENCE,             // A card from one place in the sequences into a gap
+    SOLVITAIRE_MOVE_ACCORDION             // An accordion pile onto another, closing the gap it leaves
+} solvitaire_move_type;
+
+typedef struct {
+    solvitaire_move_type type;
+    solvitaire_pile from;
+    solvitaire_pile to;
+    int8_t count;
+    // The card that lands on the pile moved to (the lowest, if several), as
+    // written in deal files, or empty for moves that deal to several piles
+    char card[4];
+    // Whether the move turns up the card left on top of the pile moved from
+    uint8_t reveals_card;
+} solvitaire_move;
+
+SOLVITAIRE_API const char* solvitaire_version(void);
+// Why the last call on this thread failed
+SOLVITAIRE_API const char* solvitaire_last_error(void);
+
+/* Rules */
+
+// The rules of one of the games listed by 'solvitaire --available-game-types'
+SOLVITAIRE_API solvitaire_rules* solvitaire_rules_from_preset(const char* type);
+// Rules written as they are for 'solvitaire --custom-rules'
+SOLVITAIRE_API solvitaire_rules* solvitaire_rules_from_json(const char* json);
+SOLVITAIRE_API void solvitaire_rules_free(solvitaire_rules*);
+
+/* Deals */
+
+// A deal keeps its own copy of the rules, which may be freed straight away
+SOLVITAIRE_API solvitaire_deal* solvitaire_deal_from_seed(const solvitaire_rules*, int seed);
+SOLVITAIRE_API solvitaire_deal* solvitaire_deal_from_json(const solvitaire_rules*, const char* json);
+SOLVITAIRE_API void solvitaire_deal_free(solvitaire_deal*);
+
+/* Solving */
+
+// Fills in the options the solvitaire executable uses by default
+SOLVITAIRE_API void solvitaire_options_init(solvitaire_options*);
+
+// A solver keeps its own copy of the deal, which may be freed straight away.
+// The options may be NULL, for the defaults
+SOLVITAIRE_API solvitaire_solver* solvitaire_solver_create(const solvitaire_deal*, const solvitaire_options*);
+// Searches the deal. A solver can only be run once
+SOLVITAIRE_API int solvitaire_solver_run(solvitaire_solver*, solvitaire_result*);
+// Stops a run on another thread, which then ends with SOLVITAIRE_CANCELLED.
+// If the solver hasn't yet been run, its run ends as soon as it starts
+SOLVITAIRE_API void solvitaire_solver_cancel(solvitaire_solver*);
+// Copies up to max_moves moves of the solution, returning how many there are
+SOLVITAIRE_API size_t solvitaire_solver_solution(const solvitaire_solver*, solvitaire_move* moves, size_t max_moves);
+SOLVITAIRE_API void solvitaire_solver_free(solvitaire_solver*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOLVITAIRE_API_H
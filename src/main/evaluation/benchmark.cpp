@@ -21,9 +21,11 @@
 // Created by thecharlesblake on 4/5/18.
 //
 
+#include <algorithm>
 #include <climits>
 #include <iostream>
 #include <numeric>
+#include <random>
 
 #include "benchmark.h"
 #include "../game/search-state/game_state.h"
@@ -32,11 +34,19 @@
 using namespace std;
 typedef chrono::microseconds microsec;
 
-void benchmark::run(const sol_rules &rules, uint64_t cache_capacity, game_state::streamliner_options streamliners) {
+// The number of moves in the walk used to time hashing
+static const int hash_walk_length = 1000;
+static volatile size_t hash_sink;
+
+void benchmark::run(const sol_rules &rules, const cache_options& cache_opts, game_state::streamliner_options streamliners) {
+    // The engine depends only on the rules, so is the same for every seed
+    cout << "Move Generation Engine: " << game_state(rules, 1, streamliners).get_engine() << "\n";
     cout << "Seed "
             "| Median/Mean Solution Time(μs) "
             "| Median/Mean States Searched "
-            "| Solvable/Unsolvable";
+            "| States Searched/Second "
+            "| Solvable/Unsolvable "
+            "| Move + Full/Incremental Hash Time(μs)";
 
     multiset<int> sol_times;
     multiset<int> states_searched;
@@ -44,10 +54,16 @@ void benchmark::run(const sol_rules &rules, uint64_t cache_capacity, game_state:
     int total_states = 0;
     int total_solvable = 0;
     int total_unsolvable = 0;
+    microsec total_full_hash_time(0);
+    microsec total_incr_hash_time(0);
 
     for(int seed = 1; seed <= 1000; seed++) {
         game_state gs(rules, seed, streamliners);
-        solver sol(gs, cache_capacity);
+        solver sol(gs, cache_opts);
+
+        auto hash_times = time_hashing(gs, seed);
+        total_full_hash_time += hash_times.first;
+        total_incr_hash_time += hash_times.second;
 
         auto start = chrono::steady_clock::now();
         solver::result result = sol.run();
@@ -76,7 +92,50 @@ void benchmark::run(const sol_rules &rules, uint64_t cache_capacity, game_state:
              << "/" << total_time/sol_times.size()
              << " | " << *next(begin(states_searched), (states_searched.size())/2)
              << "/" << total_states/sol_times.size()
+             << " | " << static_cast<long long>(total_states) * 1000000 / max(total_time, 1)
              << " | " << total_solvable
-             <<  "/"  << total_unsolvable;
+             <<  "/"  << total_unsolvable
+             << " | " << total_full_hash_time.count()
+             <<  "/"  << total_incr_hash_time.count();
+    }
+}
+
+// Makes a random walk of moves from the given state, then times replaying it
+// while building and hashing each state's cached key in full (as the cache
+// used to), and while reading the running hash. Both include the cost of
+// making the moves, as that is where the running hash is kept up to date
+pair<microsec, microsec> benchmark::time_hashing(game_state gs, int seed) {
+    mt19937 rng(static_cast<mt19937::result_type>(seed));
+    vector<::move> walk;
+    for (int i = 0; i < hash_walk_length; i++) {
+        vector<::move> moves = gs.get_legal_moves();
+        if (moves.empty()) break;
+
+        ::move m = moves[rng() % moves.size()];
+        gs.make_move(m);
+        walk.push_back(m);
     }
+    for (auto i = walk.rbegin(); i != walk.rend(); i++) gs.undo_move(*i);
+
+    state_key_format key_format(gs);
+    vector<cached_game_state::word> key(key_format.words);
+    hasher full_hasher(key_format);
+    auto start = chrono::steady_clock::now();
+    for (::move m : walk) {
+        gs.make_move(m);
+        hash_sink = hash_sink ^ full_hasher.full_hash(cached_game_state(gs, key_format, key.data()));
+    }
+    auto mid = chrono::steady_clock::now();
+
+    for (auto i = walk.rbegin(); i != walk.rend(); i++) gs.undo_move(*i);
+
+    auto mid2 = chrono::steady_clock::now();
+    for (::move m : walk) {
+        gs.make_move(m);
+        hash_sink = hash_sink ^ gs.get_hash();
+    }
+    auto end = chrono::steady_clock::now();
+
+    return make_pair(chrono::duration_cast<microsec>(mid - start),
+                     chrono::duration_cast<microsec>(end - mid2));
 }
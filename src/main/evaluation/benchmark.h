@@ -28,10 +28,14 @@
 
 #include "../game/sol_rules.h"
 #include "../game/search-state/game_state.h"
+#include "../game/global_cache.h"
 
 class benchmark {
 public:
-    static void run(const sol_rules &rules, uint64_t, game_state::streamliner_options);
+    static void run(const sol_rules &rules, const cache_options&, game_state::streamliner_options);
+
+private:
+    static std::pair<std::chrono::microseconds, std::chrono::microseconds> time_hashing(game_state, int);
 };
 
 
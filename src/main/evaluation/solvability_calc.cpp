@@ -20,13 +20,16 @@
 //
 // Created by thecharlesblake on 3/21/18.
 //
+#include <algorithm>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 #include <omp.h>
 
 #include "solvability_calc.h"
 #include "../solver/solver.h"
+#include "../solver/portfolio.h"
 #include "binomial_ci.h"
 
 using namespace std;
@@ -40,8 +43,8 @@ typedef std::chrono::milliseconds millisec;
 // SETUP METHODS //
 ///////////////////
 
-solvability_calc::solvability_calc(const sol_rules& r, uint64_t cache_capacity_) :
-        rules(r), cache_capacity(cache_capacity_) {
+solvability_calc::solvability_calc(const sol_rules& r, const cache_options& cache_opts_, uint threads_per_deal_) :
+        rules(r), cache_opts(cache_opts_), threads_per_deal(threads_per_deal_), seed_changes(0) {
 }
 
 //////////////////////
@@ -68,9 +71,9 @@ void solvability_calc::print_seed_info(seed_result seed_res) {
     solver::print_result_csv(res);
 }
 
-void solvability_calc::print_seeds_in_prog(std::set<int>& seeds_in_progress) {
+void solvability_calc::print_seeds_in_prog(seeds_in_progress_map& seeds_in_progress) {
     for(auto iter = begin(seeds_in_progress); iter != end(seeds_in_progress); ++iter) {
-        cout << ", " << *iter;
+        cout << ", " << iter->first;
     }
 
     cout << "\n";
@@ -100,81 +103,117 @@ void solvability_calc::calculate_solvability_percentage(uint64_t timeout_, int s
     solver::print_header(timeout.count(), stream_opt_);
     seed_count = seed_count_;
     stream_opt = stream_opt_;
+    resume_next = 0;
 
-    vector<std::thread> threads(cores);
+    // Smart solvability searches each seed on a thread per streamliner option,
+    // and those threads count against the cores
+    workers = std::max(1u, cores / portfolio::threads_per_deal(stream_opt, threads_per_deal));
 
-    for (uint c = 0; c < cores; c++)
-        threads[c] = std::thread(solver_thread, this, c);
+    vector<std::thread> threads(workers);
 
-    for (uint c = 0; c < cores; c++)
+    for (uint c = 0; c < workers; c++)
+        threads[c] = std::thread(solver_thread, this);
+
+    for (uint c = 0; c < workers; c++)
         threads[c].join();
 }
 
-void solvability_calc::solver_thread(solvability_calc* sc, uint core) {
-    int my_seed = sc->resume_seeds.size() > core ? sc->resume_seeds[core] : sc->current_seed++;
+// The seeds that were in progress when the run being resumed stopped come
+// first
+int solvability_calc::next_seed() {
+    const std::size_t r = resume_next++;
+    return r < resume_seeds.size() ? resume_seeds[r] : current_seed++;
+}
+
+void solvability_calc::solver_thread(solvability_calc* sc) {
+    const bool smart = sc->stream_opt == cmd_sos::SMART;
+    const vector<portfolio::config> configs = portfolio::for_streamliners(sc->stream_opt, sc->timeout);
+    // Helpers join the seed's search if its cache can be shared, and race
+    // other streamliners otherwise
+    const uint helpers = sc->workers - 1;
+
+    int my_seed = sc->next_seed();
 
     while (my_seed < sc->seed_count) {
+        // The other threads may join the search once they run out of seeds,
+        // so each seed's portfolio is kept alive for as long as they need it
+        const auto p = std::make_shared<const portfolio>(configs, sc->cache_opts, sc->threads_per_deal, helpers);
+
         sc->results_mutex.lock();
-        sc->seeds_in_progress.insert(my_seed);
+        sc->seeds_in_progress[my_seed] = seed_in_progress{p, std::chrono::steady_clock::now(), 0};
         sc->results_mutex.unlock();
 
-        optional<seed_result> stream_res, no_stream_res, final_res;
-
-        if (sc->stream_opt == cmd_sos::SMART) {
-            stream_res = solve_seed(my_seed, (sc->timeout/10), sc->rules, sc->cache_capacity, sos::BOTH);
-
-            switch (stream_res->second.sol_type) {
-                case solver::result::type::UNSOLVABLE:
-                case solver::result::type::TIMEOUT:
-                    no_stream_res = solve_seed(my_seed, sc->timeout, sc->rules, sc->cache_capacity, sos::NONE);
-                    final_res = *no_stream_res;
-                    break;
-                default:
-                    final_res = *stream_res;
-                    break;
-            }
-        } else {
-            no_stream_res = solve_seed(my_seed, sc->timeout, sc->rules, sc->cache_capacity,
-                                       command_line_helper::convert_streamliners(sc->stream_opt));
-            final_res = *no_stream_res;
-        }
+        search_budget budget(sc->timeout);
+        const portfolio::outcome out = p->run([&](sos str_opts) {
+            return game_state(sc->rules, my_seed, str_opts);
+        }, budget, [sc] {
+            std::lock_guard<std::mutex> lock(sc->results_mutex);
+            sc->seed_changes++;
+            sc->seeds_changed.notify_all();
+        });
+        const solver::result::type final_type = out.answer().res.sol_type;
 
         sc->results_mutex.lock();
 
         sc->seeds_in_progress.erase(my_seed);
-        sc->seed_res.add_result(final_res->second.sol_type);
+        sc->seed_changes++;
+        sc->seeds_changed.notify_all();
+        sc->seed_res.add_result(final_type);
 
         cout << my_seed;
         //print_general_info(sc->seed_res);
-        if (sc->stream_opt == cmd_sos::SMART) {
-            print_seed_info(*stream_res);
-            if (no_stream_res) {
-                print_seed_info(*no_stream_res);
-                cout << ", " << no_stream_res->second.sol_type;
-            } else {
-                solver::print_null_seed_info();
-                cout << ", " << stream_res->second.sol_type;
-            }
+        if (smart) {
+            for (const portfolio::attempt& a : out.attempts) print_seed_info(seed_result(my_seed, a.res));
         } else {
-            print_seed_info(*no_stream_res);
-            cout << ", " << no_stream_res->second.sol_type;
+            print_seed_info(seed_result(my_seed, out.answer().res));
         }
+        cout << ", " << final_type;
         //print_seeds_in_prog(sc->seeds_in_progress);
         cout << "\n";
 
         sc->results_mutex.unlock();
 
-        my_seed = sc->current_seed++;
+        my_seed = sc->next_seed();
     }
+
+    if (helpers > 0) help_seeds_in_progress(sc);
 }
 
-solvability_calc::seed_result solvability_calc::solve_seed(int seed, millisec timeout, const sol_rules& rules,
-                                                          uint64_t cache_capacity,
-                                                          game_state::streamliner_options stream_opt) {
-    game_state gs(rules, seed, stream_opt);
-    solver sol(gs, cache_capacity);
+// Once there are no seeds left to start, the run's time is that of its
+// slowest seeds, so the thread helps their searches rather than leaving its
+// core idle. It tries the seeds with the fewest helpers first, and of those
+// the ones searched for longest, until no seed is left in progress
+void solvability_calc::help_seeds_in_progress(solvability_calc* sc) {
+    typedef pair<int, seed_in_progress> candidate;
+    std::unique_lock<std::mutex> lock(sc->results_mutex);
+
+    while (!sc->seeds_in_progress.empty()) {
+        const uint64_t changes = sc->seed_changes;
+        vector<candidate> candidates(begin(sc->seeds_in_progress), end(sc->seeds_in_progress));
+        std::sort(begin(candidates), end(candidates), [](const candidate& a, const candidate& b) {
+            return a.second.helpers != b.second.helpers ? a.second.helpers < b.second.helpers
+                    : a.second.started < b.second.started;
+        });
+
+        bool helped = false;
+        for (const candidate& c : candidates) {
+            auto s = sc->seeds_in_progress.find(c.first);
+            if (s == end(sc->seeds_in_progress) || s->second.search != c.second.search) continue;
+            s->second.helpers++;
+            lock.unlock();
+
+            helped = c.second.search->help();
+
+            lock.lock();
+            s = sc->seeds_in_progress.find(c.first);
+            if (s != end(sc->seeds_in_progress) && s->second.search == c.second.search) s->second.helpers--;
+            if (helped) break;
+        }
 
-    return seed_result(seed, sol.run(optional<std::chrono::milliseconds>(timeout)));
+        // No seed could be helped, as their searches have yet to start, are
+        // just finishing, or have nothing left to race
+        if (!helped) sc->seeds_changed.wait(lock, [sc, changes] { return sc->seed_changes != changes; });
+    }
 }
 
 
@@ -25,17 +25,20 @@
 #define SOLVITAIRE_SOLVABILITY_H
 
 #include <vector>
-#include <set>
+#include <map>
+#include <memory>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
 
 #include "../game/sol_rules.h"
 #include "../solver/solver.h"
+#include "../solver/portfolio.h"
 #include "../input-output/input/command_line_helper.h"
 
 class solvability_calc {
 public:
-    explicit solvability_calc(const sol_rules&, uint64_t);
+    solvability_calc(const sol_rules&, const cache_options&, uint = 1);
 
     void calculate_solvability_percentage(uint64_t, int, uint, command_line_helper::streamliner_opt, const std::vector<int>&);
 
@@ -52,24 +55,39 @@ private:
         std::atomic<int> mem_limit;
     };
 
+    // A seed being searched, and the threads helping to search it
+    struct seed_in_progress {
+        std::shared_ptr<const portfolio> search;
+        std::chrono::steady_clock::time_point started;
+        uint helpers;
+    };
+    typedef std::map<int, seed_in_progress> seeds_in_progress_map;
+
     // Printing methods
     static void print_general_info(const seed_results&);
     static void print_seed_info(seed_result);
-    static void print_seeds_in_prog(std::set<int>&);
+    static void print_seeds_in_prog(seeds_in_progress_map&);
 
     // Solving methods
-    static void solver_thread(solvability_calc*, uint core);
-    static seed_result solve_seed(int, std::chrono::milliseconds, const sol_rules&, uint64_t, game_state::streamliner_options);
+    static void solver_thread(solvability_calc*);
+    static void help_seeds_in_progress(solvability_calc*);
+    int next_seed();
 
     const sol_rules& rules;
-    const uint64_t cache_capacity;
+    const cache_options cache_opts;
+    const uint threads_per_deal;
     std::chrono::milliseconds timeout;
     std::mutex results_mutex;
     seed_results seed_res;
-    std::set<int> seeds_in_progress;
+    seeds_in_progress_map seeds_in_progress;
+    // Signalled when a seed's search starts or ends, counted by seed_changes
+    std::condition_variable seeds_changed;
+    uint64_t seed_changes;
     std::vector<int> resume_seeds;
+    std::atomic<std::size_t> resume_next;
     std::atomic<int> current_seed;
     int seed_count;
+    uint workers; // The threads that each take seeds of their own
     command_line_helper::streamliner_opt stream_opt;
 };
 
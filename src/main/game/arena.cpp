@@ -0,0 +1,133 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <cstdlib>
+#include <cassert>
+#include <new>
+#include <algorithm>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+using std::size_t;
+
+// Chunks start small, so that small searches stay small, and double up to a
+// limit. With huge pages, chunks are whole, aligned huge pages
+static const size_t min_chunk_size = size_t(1) << 20;
+static const size_t max_chunk_size = size_t(1) << 26;
+static const size_t huge_page_size = size_t(1) << 21;
+
+arena::arena(bool huge_pages_)
+        : huge_pages(huge_pages_)
+        , chunks()
+        , free_lists()
+        , cur(nullptr)
+        , end(nullptr)
+        , reserved(0) {
+}
+
+arena::~arena() {
+    release();
+}
+
+// Every block is big enough, and aligned enough, to hold a free list link
+size_t arena::block_size(size_t bytes) {
+    bytes = std::max(bytes, sizeof(free_block));
+    return (bytes + alignof(free_block) - 1) & ~(alignof(free_block) - 1);
+}
+
+void* arena::allocate(size_t bytes, size_t align) {
+    bytes = block_size(bytes);
+
+    for (auto& fl : free_lists) {
+        if (fl.first == bytes && fl.second
+                && reinterpret_cast<uintptr_t>(fl.second) % align == 0) {
+            free_block* b = fl.second;
+            fl.second = b->next;
+            return b;
+        }
+    }
+
+    char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cur) + align - 1) & ~uintptr_t(align - 1));
+    if (!cur || p + bytes > end) {
+        new_chunk(bytes + align);
+        p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cur) + align - 1) & ~uintptr_t(align - 1));
+    }
+    cur = p + bytes;
+    return p;
+}
+
+void arena::deallocate(void* p, size_t bytes) {
+    bytes = block_size(bytes);
+    auto b = static_cast<free_block*>(p);
+
+    for (auto& fl : free_lists) {
+        if (fl.first == bytes) {
+            b->next = fl.second;
+            fl.second = b;
+            return;
+        }
+    }
+    b->next = nullptr;
+    free_lists.emplace_back(bytes, b);
+}
+
+void arena::new_chunk(size_t min_bytes) {
+    size_t size = chunks.empty() ? min_chunk_size : std::min(chunks.back().second * 2, max_chunk_size);
+    size = std::max(size, min_bytes);
+
+    void* mem = nullptr;
+    if (huge_pages) {
+        size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+        if (posix_memalign(&mem, huge_page_size, size) != 0) mem = nullptr;
+        if (mem) advise_huge_pages(mem, size);
+    } else {
+        mem = malloc(size);
+    }
+    if (!mem) throw std::bad_alloc();
+
+    chunks.emplace_back(mem, size);
+    reserved += size;
+    cur = static_cast<char*>(mem);
+    end = cur + size;
+}
+
+// Frees every chunk. Anything still allocated from the arena is lost, and is
+// not destructed, so the arena must only hold objects that need no cleanup
+void arena::release() {
+    for (auto& c : chunks) free(c.first);
+    chunks.clear();
+    free_lists.clear();
+    cur = end = nullptr;
+    reserved = 0;
+}
+
+uint64_t arena::bytes_reserved() const {
+    return reserved;
+}
+
+void arena::advise_huge_pages(void* p, size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#else
+    (void) p;
+    (void) bytes;
+#endif
+}
@@ -0,0 +1,96 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_ARENA_H
+#define SOLVITAIRE_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// Hands out memory from a few large chunks, so that everything allocated from
+// it is freed at once when it is released, rather than block by block. Freed
+// blocks are kept on a list for their size and reused by later allocations of
+// that size. Not thread-safe
+class arena {
+public:
+    explicit arena(bool = false);
+    ~arena();
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t, std::size_t = alignof(std::max_align_t));
+    void deallocate(void*, std::size_t);
+    void release();
+    uint64_t bytes_reserved() const;
+
+    // Asks the OS to back the given memory with transparent huge pages
+    static void advise_huge_pages(void*, std::size_t);
+
+private:
+    struct free_block {
+        free_block* next;
+    };
+
+    static std::size_t block_size(std::size_t);
+    void new_chunk(std::size_t);
+
+    bool huge_pages;
+    std::vector<std::pair<void*, std::size_t>> chunks;
+    std::vector<std::pair<std::size_t, free_block*>> free_lists;
+    char* cur;
+    char* end;
+    uint64_t reserved;
+};
+
+// Allocates from an arena, for use in standard and Boost containers
+template<class T>
+class arena_allocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<class U> struct rebind {
+        typedef arena_allocator<U> other;
+    };
+
+    explicit arena_allocator(arena* a) noexcept : mem(a) {}
+    template<class U> arena_allocator(const arena_allocator<U>& o) noexcept : mem(o.mem) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(mem->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, std::size_t n) {
+        mem->deallocate(p, n * sizeof(T));
+    }
+
+    template<class U> bool operator==(const arena_allocator<U>& o) const { return mem == o.mem; }
+    template<class U> bool operator!=(const arena_allocator<U>& o) const { return mem != o.mem; }
+
+    arena* mem;
+};
+
+#endif //SOLVITAIRE_ARENA_H
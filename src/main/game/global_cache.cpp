@@ -3,6 +3,9 @@
 //
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 
 #include <boost/functional/hash.hpp>
 
@@ -17,174 +20,226 @@ typedef sol_rules::build_policy pol;
 typedef sol_rules::stock_deal_type sdt;
 typedef game_state::streamliner_options sos;
 
-typedef boost::multi_index::multi_index_container<
-        cached_game_state,
-        boost::multi_index::indexed_by<
-                boost::multi_index::sequenced<>,
-                boost::multi_index::hashed_unique<
-                        boost::multi_index::identity<cached_game_state>,
-                        hasher
-                >
-        >
-> item_list;
+typedef sol_rules::face_up_policy fu;
+typedef lru_cache::item_list item_list;
+
+
+//////////////////////
+// STATE KEY FORMAT //
+//////////////////////
+
+state_key_format::state_key_format(const game_state& gs)
+        : max_rank(gs.rules.max_rank)
+        , face_down_possible(gs.rules.face_up == fu::TOP_CARDS) {
+    // If the game is a 'hole-based' game, or suit-reduction is on, the
+    // cached suit of each card is reduced where possible
+    bool is_suit_symmetry = (gs.rules.foundations_present
+            && (gs.stream_opts == sos::SUIT_SYMMETRY || gs.stream_opts == sos::BOTH))
+            || gs.rules.hole;
+
+    reduction = suit_reduction::NONE;
+    uint8_t suit_count = 4;
+    if (is_suit_symmetry) {
+        switch (gs.rules.build_pol) {
+            case pol::SAME_SUIT:
+                break;
+            case pol::RED_BLACK:
+                reduction = suit_reduction::COLOUR;
+                suit_count = 2;
+                break;
+            default:
+                reduction = suit_reduction::ALL;
+                suit_count = 1;
+                break;
+        }
+    }
+
+    // Symbol zero is the divider
+    unsigned symbol_count = 1u + suit_count * max_rank * (face_down_possible ? 2u : 1u);
+    bits_per_symbol = 1;
+    while ((1u << bits_per_symbol) < symbol_count) bits_per_symbol++;
+
+    const sol_rules& r = gs.rules;
+    unsigned max_symbols = max_rank * 4u * (r.two_decks ? 2u : 1u)
+            + (r.cells > 0 ? 1u : 0u)
+            + (r.stock_size > 0 ? 2u : 0u)
+            + (r.reserve_size > 0 ? 1u : 0u)
+            + r.tableau_pile_count
+            + r.sequence_count;
+    words = static_cast<uint16_t>((max_symbols * bits_per_symbol + 63) / 64);
+}
+
+uint8_t state_key_format::symbol(card c) const {
+    uint8_t suit_val;
+    switch (reduction) {
+        case suit_reduction::NONE:
+            suit_val = c.get_suit();
+            break;
+        case suit_reduction::COLOUR:
+            suit_val = c.get_colour();
+            break;
+        default:
+            suit_val = 0;
+            break;
+    }
+
+    unsigned val = suit_val * max_rank + (c.get_rank() - 1u);
+    if (face_down_possible) val = val * 2 + c.is_face_down();
+
+    assert(c.get_rank() >= 1 && c.get_rank() <= max_rank);
+    return static_cast<uint8_t>(val + 1);
+}
+
+uint64_t state_key_format::bytes() const {
+    return words * sizeof(word);
+}
 
 
 ///////////////////////
 // CACHED GAME STATE //
 ///////////////////////
 
-cached_game_state::cached_game_state(const game_state& gs) : live(true) {
-    data.reserve(52+18);  // Enough for each card and up to 18 piles
+// Writes symbols into a zeroed key, least significant bits first
+class cached_game_state::key_writer {
+public:
+    key_writer(const game_state& gs_, const state_key_format& fmt_, word* key_)
+            : gs(gs_), fmt(fmt_), key(key_), bit_pos(0) {
+        memset(key, 0, fmt.bytes());
+    }
+
+    void add_pile(pile::ref pr) {
+        for (pile::size_type i = 0; i < gs.piles[pr].size(); i++) {
+            add_card(gs.piles[pr].cards[i]);
+        }
+    }
+
+    void add_pile_in_reverse(pile::ref pr) {
+        for (auto i = gs.piles[pr].size(); i-->0;) {
+            add_card(gs.piles[pr].cards[i]);
+        }
+    }
+
+    void add_card(card c) {
+        add_symbol(fmt.symbol(c));
+    }
+
+    void add_card_divider() {
+        add_symbol(0);
+    }
+
+private:
+    void add_symbol(uint8_t sym) {
+        assert(bit_pos + fmt.bits_per_symbol <= fmt.words * 64u);
+
+        unsigned w = bit_pos / 64, offset = bit_pos % 64;
+        key[w] |= word(sym) << offset;
+        if (offset + fmt.bits_per_symbol > 64) {
+            key[w + 1] |= word(sym) >> (64 - offset);
+        }
+        bit_pos += fmt.bits_per_symbol;
+    }
+
+    const game_state& gs;
+    const state_key_format& fmt;
+    word* key;
+    unsigned bit_pos;
+};
+
+cached_game_state::cached_game_state(const game_state& gs, const state_key_format& fmt, word* key)
+        : data(key), hash(gs.get_hash()), live(true), referenced(false), credit(0) {
+    key_writer kw(gs, fmt, key);
 
     if (gs.rules.hole) {
-        add_card(gs.piles[gs.hole].top_card(), gs);
+        kw.add_card(gs.piles[gs.hole].top_card());
     }
 
     for (pile::ref pr : gs.cells) {
-        add_pile(pr, gs);
+        kw.add_pile(pr);
     }
     if (gs.rules.cells > 0) {
-        add_card_divider();
+        kw.add_card_divider();
     }
 
     if (gs.rules.stock_size > 0) {
-        add_pile(gs.stock, gs);
+        kw.add_pile(gs.stock);
 
         if (gs.rules.stock_deal_t == sdt::WASTE) {
             bool waste_deal_symmetry = gs.rules.stock_redeal
                     && gs.piles[gs.waste].size() % gs.rules.stock_deal_count == 0;
 
             if (waste_deal_symmetry) {
-                add_pile_in_reverse(gs.waste, gs);
+                kw.add_pile_in_reverse(gs.waste);
             } else {
-                add_card_divider();
-                add_pile_in_reverse(gs.waste, gs);
+                kw.add_card_divider();
+                kw.add_pile_in_reverse(gs.waste);
             }
         }
-        
-        add_card_divider();
+
+        kw.add_card_divider();
     }
 
     for (pile::ref pr : gs.reserve) {
-        add_pile(pr, gs);
-        }
+        kw.add_pile(pr);
+    }
     if (gs.rules.reserve_size > 0) {
-        add_card_divider();
+        kw.add_card_divider();
     }
 
     for (pile::ref pr : gs.tableau_piles) {
-        add_pile(pr, gs);
-        add_card_divider();
+        kw.add_pile(pr);
+        kw.add_card_divider();
     }
 
     for (pile::ref pr : gs.sequences) {
-        add_pile(pr, gs);
-        add_card_divider();
+        kw.add_pile(pr);
+        kw.add_card_divider();
     }
 
     for (pile::ref pr : gs.accordion) {
-        add_card(gs.piles[pr].top_card(), gs);
+        kw.add_card(gs.piles[pr].top_card());
     }
 }
 
 
-void cached_game_state::add_pile(pile::ref pr, const game_state& gs) {
-    for (card c : gs.piles[pr].pile_vec) {
-        add_card(c, gs);
-    }
-}
+/////////////////
+// STATE CACHE //
+/////////////////
 
-void cached_game_state::add_pile_in_reverse(pile::ref pr, const game_state& gs) {
-    for (auto i = gs.piles[pr].pile_vec.size(); i-->0;) {
-        card c = gs.piles[pr].pile_vec[i];
-        add_card(c, gs);
-    }
+void state_cache::eviction_stats::record(uint64_t scan_length) {
+    scans++;
+    total_scan_length += scan_length;
+    max_scan_length = max(max_scan_length, scan_length);
 }
 
-void cached_game_state::add_card(card c, const game_state& gs) {
-    auto& target = data;
-
-    // If the game is a 'hole-based' game, or suit-reduction is on, reduces
-    // the cached suit of the card where possible
-
-    bool is_suit_symmetry = (gs.rules.foundations_present
-            && (gs.stream_opts == sos::SUIT_SYMMETRY || gs.stream_opts == sos::BOTH))
-            || gs.rules.hole;
-
-    if (is_suit_symmetry) {
-        switch (gs.rules.build_pol) {
-            case pol::SAME_SUIT:
-                target.emplace_back(c);
-                break;
-            case pol::RED_BLACK:
-                target.emplace_back(card(c.get_colour(), c.get_rank(), c.is_face_down()));
-                break;
-            default:
-                target.emplace_back(card(0, c.get_rank(), c.is_face_down()));
-                break;
-        }
-    } else {
-        target.emplace_back(c);
-    }
-}
-
-void cached_game_state::add_card_divider() {
-    data.emplace_back(card::divider);
-}
-
-bool operator==(const cached_game_state& a, const cached_game_state& b) {
-    return a.data == b.data;
-}
-
-
 
 //////////////////
 // STATE HASHER //
 //////////////////
 
-hasher::hasher(const game_state& gs) : init_gs(gs) {
+hasher::hasher(const state_key_format& fmt) : words(fmt.words) {
 }
 
+// The game state keeps its hash up to date as moves are made, so there is no
+// need to walk over the cached key
 size_t hasher::operator()(const cached_game_state& cgs) const {
-    size_t seed = 0;
+    return cgs.hash;
+}
 
-    for (card d : cgs.data) {
-        combine(seed, hash_value(d));
+// Hashes every word of the cached key. Kept as a benchmark baseline for the
+// running hash
+size_t hasher::full_hash(const cached_game_state& cgs) const {
+    size_t seed = 0;
+    for (uint16_t i = 0; i < words; i++) {
+        hash_combine(seed, cgs.data[i]);
     }
     return seed;
 }
 
-std::size_t hasher::combine(std::size_t& seed, std::size_t value) const {
-    return seed ^= value + 0x9e3779b9 + (seed<<6) + (seed>>2);
+key_equal::key_equal(const state_key_format& fmt) : words(fmt.words) {
 }
 
-size_t hasher::hash_value(card const& c) const {
-    boost::hash<uint8_t> boost_hasher;
-
-    // If the game is a 'hole-based' game, or suit-reduction is enabled, hash
-    // the reduced suit
-    bool is_suit_symmetry = (init_gs.rules.foundations_present
-                             && (init_gs.stream_opts == sos::SUIT_SYMMETRY || init_gs.stream_opts == sos::BOTH))
-                            || init_gs.rules.hole;
-
-    uint8_t suit_val;
-    if (is_suit_symmetry) {
-        switch (init_gs.rules.build_pol) {
-            case pol::SAME_SUIT:
-                suit_val = c.get_suit();
-                break;
-            case pol::RED_BLACK:
-                suit_val = c.get_colour();
-                break;
-            default:
-                suit_val = 0;
-        }
-    } else {
-        suit_val = c.get_suit();
-    }
-
-    auto raw_val = static_cast<uint8_t>(suit_val * 26 + 2*c.get_rank() + c.is_face_down());
-    return boost_hasher(raw_val);
+bool key_equal::operator()(const cached_game_state& a, const cached_game_state& b) const {
+    return memcmp(a.data, b.data, words * sizeof(cached_game_state::word)) == 0;
 }
 
 
@@ -203,73 +258,752 @@ size_t hasher::hash_value(card const& c) const {
  * See http://www.boost.org/libs/multi_index for library home page.
  */
 
-item_list::ctor_args_list lru_cache::get_init_tuple(const game_state& gs) {
+item_list::ctor_args_list lru_cache::get_init_tuple(const state_key_format& fmt) {
     return boost::make_tuple(
             item_list::nth_index<0>::type::ctor_args(),
             boost::make_tuple(
                     size_t(0),
                     multi_index::identity<cached_game_state>(),
-                    hasher(gs),
-                    equal_to<cached_game_state>()
+                    hasher(fmt),
+                    key_equal(fmt)
                     )
             );
 }
 
-lru_cache::lru_cache(const game_state& gs, uint64_t max_num_items_)
-        : max_num_items(max_num_items_), cache(get_init_tuple(gs)), states_removed_from_cache(0) {
+lru_cache::lru_cache(const game_state& gs, uint64_t max_num_items_, eviction_policy eviction_, uint64_t max_bytes_,
+                     bool huge_pages, bool keep_dead_states)
+        : max_num_items(max_num_items_)
+        , max_bytes(max_bytes_)
+        , peak_bytes(0)
+        , key_format(gs)
+        , mem(huge_pages)
+        , cache(*new (mem.allocate(sizeof(item_list), alignof(item_list)))
+                item_list(get_init_tuple(key_format), item_list::allocator_type(&mem)))
+        , probe_key(key_format.words)
+        , states_removed_from_cache(0)
+        , eviction(eviction_)
+        , evict_stats{0, 0, 0}
+        , dead_states(keep_dead_states ? new dead_state_set(max_bytes_ / 2) : nullptr)
+        , dead_state_hits(0)
+        , hand(cache.end()) {
 }
 
-pair<item_list::iterator, bool> lru_cache::insert(const game_state& gs) {
-    pair<item_list::iterator, bool> p = cache.push_front(cached_game_state(gs));
+// Packs the state into the probe key first, so that keys are only allocated
+// for states that are not already in the cache
+pair<state_cache::handle, bool> lru_cache::insert(const game_state& gs) {
+    cached_game_state cgs(gs, key_format, probe_key.data());
+
+    auto hashed_iter = cache.get<1>().find(cgs);
+    if (hashed_iter != cache.get<1>().end()) {         /* duplicate item */
+        auto state_iter = cache.project<0>(hashed_iter);
+        if (eviction == eviction_policy::CLOCK) {
+            state_iter->referenced = true;
+        } else {
+            cache.relocate(cache.begin(), state_iter); /* put in front */
+        }
+        return make_pair(reinterpret_cast<handle>(&*state_iter), false);
+    }
+
+    // A state evicted after being searched in full needs no searching again
+    if (dead_states && dead_states->contains(cgs.hash)) {
+        dead_state_hits++;
+        return make_pair(handle(0), false);
+    }
 
-    if(!p.second){                              /* duplicate item */
-        cache.relocate(cache.begin(), p.first); /* put in front */
-    } else if(cache.size() > max_num_items){    /* keep the length <= max_num_items */
+    cgs.data = static_cast<cached_game_state::word*>(mem.allocate(key_format.bytes(), alignof(cached_game_state::word)));
+    memcpy(cgs.data, probe_key.data(), key_format.bytes());
 
-        // If the least recently used node is 'live' (i.e. a parent), relocates
-        // it to the head of the list until this is no longer the case
-        for (uint64_t i = 0; prev(cache.end())->live; i++) {
-            cache.relocate(cache.begin(), prev(cache.end()));
+    // New states are live, so go behind the clock's ring
+    pair<item_list::iterator, bool> p = eviction == eviction_policy::CLOCK
+            ? cache.push_back(cgs)
+            : cache.push_front(cgs);
+    assert(p.second);
 
-            if (i == max_num_items) {
+    while (is_full()) {                     /* keep within the item and byte limits */
+        switch (eviction) {
+            case eviction_policy::CLOCK:
+                evict_clock();
+                break;
+            case eviction_policy::COST:
+                evict_cost();
+                break;
+            case eviction_policy::LRU:
+            default:
+                evict_lru();
+                break;
+        }
+        states_removed_from_cache++;
+    }
+    peak_bytes = max(peak_bytes, bytes_used());
+
+    return make_pair(reinterpret_cast<handle>(&*p.first), true);
+}
+
+// The bucket array only grows, so once it has, more states are evicted to
+// stay within the byte limit
+bool lru_cache::is_full() const {
+    return cache.size() > max_num_items
+           || (max_bytes > 0 && cache.size() > 1 && bytes_used() > max_bytes);
+}
+
+// If the least recently used node is 'live' (i.e. a parent), relocates it to
+// the head of the list until this is no longer the case
+void lru_cache::evict_lru() {
+    uint64_t scan_length = 1;
+    for (uint64_t i = 0; prev(cache.end())->live; i++, scan_length++) {
+        cache.relocate(cache.begin(), prev(cache.end()));
+
+        if (i == max_num_items) {
+#ifndef NDEBUG
+            LOG_ERROR("All items in cache are live and cache is full");
+#endif
+            throw runtime_error("All items in cache are live and cache is full");
+        }
+    }
+    evict_stats.record(scan_length);
+
+    remove(prev(cache.end()));
+}
+
+// As with LRU, but a state at the back with credit left spends one and is
+// moved to the front, so expensive subtrees outlast cheap ones. Credit is
+// only given out once per state, so the scan is amortised O(1)
+void lru_cache::evict_cost() {
+    uint64_t scan_length = 1;
+    for (uint64_t live_run = 0; ; scan_length++) {
+        auto back = prev(cache.end());
+
+        if (back->live) {
+            if (++live_run > cache.size()) {
 #ifndef NDEBUG
                 LOG_ERROR("All items in cache are live and cache is full");
 #endif
                 throw runtime_error("All items in cache are live and cache is full");
             }
+        } else if (back->credit > 0) {
+            back->credit--;
+            live_run = 0;
+        } else {
+            break;
         }
-        cache.pop_back();
-        states_removed_from_cache++;
+        cache.relocate(cache.begin(), back);
+    }
+    evict_stats.record(scan_length);
+
+    remove(prev(cache.end()));
+}
+
+// Sweeps the ring, giving referenced states a second chance. Each state is
+// passed over at most once per lookup, so the sweep is amortised O(1)
+void lru_cache::evict_clock() {
+    uint64_t scan_length = 0;
+    for (;;) {
+        item_list::iterator h = clock_hand();
+        if (h == cache.end() || h->live) {
+            hand = cache.begin();
+            if (hand->live) {            /* the ring is empty */
+#ifndef NDEBUG
+                LOG_ERROR("All items in cache are live and cache is full");
+#endif
+                throw runtime_error("All items in cache are live and cache is full");
+            }
+            continue;
+        }
+
+        scan_length++;
+        if (h->referenced) {
+            h->referenced = false;
+            ++hand;
+            continue;
+        }
+
+        ++hand;
+        remove(h);
+        break;
     }
-    return p;
+    evict_stats.record(scan_length);
+}
+
+// Evicts a state, keeping its fingerprint if dead states are being kept
+void lru_cache::remove(item_list::iterator it) {
+    if (dead_states) dead_states->insert(it->hash);
+    mem.deallocate(it->data, key_format.bytes());
+    cache.erase(it);
+}
+
+// The hand, moved to the start of the list if it has fallen off the end
+lru_cache::item_list::iterator lru_cache::clock_hand() {
+    if (hand == cache.end()) hand = cache.begin();
+    return hand;
 }
 
 bool lru_cache::contains(const game_state& gs) const {
-    return cache.get<1>().count(cached_game_state(gs)) > 0;
+    cached_game_state cgs(gs, key_format, probe_key.data());
+    return cache.get<1>().count(cgs) > 0 || (dead_states && dead_states->contains(cgs.hash));
 }
 
 void lru_cache::clear() {
+    for (const cached_game_state& cgs : cache) mem.deallocate(cgs.data, key_format.bytes());
     cache.clear();
+    hand = cache.end();
 }
 
-item_list::size_type lru_cache::size() const {
+uint64_t lru_cache::size() const {
     return cache.size();
 }
 
-item_list::size_type lru_cache::bucket_count() const {
+uint64_t lru_cache::bucket_count() const {
     return cache.get<1>().bucket_count();
 }
 
-void lru_cache::set_non_live(item_list::iterator state_iter) {
+// The handle is the address of the cached state, which is stable for as long
+// as the state remains in the cache
+void lru_cache::set_non_live(handle h, uint64_t subtree_size) {
+    auto state_iter = cache.iterator_to(*reinterpret_cast<const cached_game_state*>(h));
+
+    uint8_t credit = 0;
+    if (eviction == eviction_policy::COST) {
+        while (credit < max_credit && subtree_size >> (credit + 1) != 0) credit++;
+    }
 #ifndef NDEBUG
     bool succ =
 #endif
-    cache.modify(state_iter, [](auto& v){ v.live = false; });
+    cache.modify(state_iter, [credit](auto& v){ v.live = false; v.credit = credit; });
 #ifndef NDEBUG
     assert(succ);
 #endif
+
+    // Joins the ring just behind the hand, so is the last state it reaches
+    if (eviction == eviction_policy::CLOCK) {
+        cache.relocate(clock_hand(), state_iter);
+    }
 }
 
 uint64_t lru_cache::get_states_removed_from_cache() const {
     return states_removed_from_cache;
 }
+
+uint64_t lru_cache::peak_bytes_used() const {
+    return peak_bytes;
+}
+
+state_cache::eviction_stats lru_cache::get_eviction_stats() const {
+    return evict_stats;
+}
+
+uint64_t lru_cache::get_dead_state_count() const {
+    return dead_states ? dead_states->size() : 0;
+}
+
+uint64_t lru_cache::get_dead_state_hits() const {
+    return dead_state_hits;
+}
+
+// An estimate of the memory held by the cache. Each state has a list node with
+// two links, a hash node with one link, and its packed key in the arena
+uint64_t lru_cache::bytes_used() const {
+    const uint64_t node_bytes = sizeof(cached_game_state) + 3 * sizeof(void*);
+    return cache.size() * (node_bytes + key_format.bytes()) + bucket_count() * sizeof(void*)
+           + (dead_states ? dead_states->bytes_used() : 0);
+}
+
+
+////////////////////
+// DEAD STATE SET //
+////////////////////
+
+// If there is a byte limit, the set stops growing at it, and further states
+// are no longer remembered
+dead_state_set::dead_state_set(uint64_t max_bytes_)
+        : slots(min_slot_count, 0)
+        , slot_mask(min_slot_count - 1)
+        , index_shift(54)
+        , item_count(0)
+        , max_bytes(max_bytes_) {
+    static_assert(uint64_t(1) << (64 - 54) == min_slot_count, "Invalid initial index shift");
+}
+
+uint64_t dead_state_set::index_of(uint64_t fp) const {
+    return fp >> index_shift;
+}
+
+void dead_state_set::grow() {
+    vector<uint64_t> old_slots(slots.size() * 2, 0);
+    old_slots.swap(slots);
+    slot_mask = slots.size() - 1;
+    index_shift--;
+    item_count = 0;
+
+    for (uint64_t fp : old_slots) {
+        if (fp != 0) insert(fp);
+    }
+}
+
+bool dead_state_set::insert(uint64_t fp) {
+    if (fp == 0) fp = 1;
+
+    // Grows once three quarters of the slots are taken
+    if ((item_count + 1) * 4 > slots.size() * 3) {
+        if (max_bytes > 0 && 2 * bytes_used() > max_bytes) return false;
+        grow();
+    }
+
+    for (uint64_t i = index_of(fp); ; i = (i + 1) & slot_mask) {
+        if (slots[i] == fp) return false;
+        if (slots[i] == 0) {
+            slots[i] = fp;
+            item_count++;
+            return true;
+        }
+    }
+}
+
+bool dead_state_set::contains(uint64_t fp) const {
+    if (fp == 0) fp = 1;
+
+    for (uint64_t i = index_of(fp); ; i = (i + 1) & slot_mask) {
+        if (slots[i] == fp) return true;
+        if (slots[i] == 0) return false;
+    }
+}
+
+uint64_t dead_state_set::size() const {
+    return item_count;
+}
+
+uint64_t dead_state_set::bytes_used() const {
+    return slots.size() * sizeof(uint64_t);
+}
+
+
+/////////////////////////
+// TRANSPOSITION TABLE //
+/////////////////////////
+
+transposition_table::transposition_table(const game_state&, uint64_t max_num_items_, uint64_t max_bytes,
+                                         bool huge_pages_)
+        : max_num_items(max_num_items_)
+        , max_bucket_count(min_bucket_count)
+        , huge_pages(huge_pages_)
+        , buckets(nullptr)
+        , bucket_mask(0)
+        , index_shift(0)
+        , item_count(0)
+        , states_removed_from_cache(0)
+        , evict_stats{0, 0, 0} {
+    // The table grows in powers of two, up until it has a slot for every state
+    while (max_bucket_count * bucket_slots < max_num_items) max_bucket_count *= 2;
+
+    // ...and within the byte limit, if there is one
+    while (max_bytes > 0 && max_bucket_count > min_bucket_count
+           && max_bucket_count * sizeof(bucket) > max_bytes) {
+        max_bucket_count /= 2;
+    }
+    allocate(min_bucket_count);
+}
+
+transposition_table::~transposition_table() {
+    free(buckets);
+}
+
+// The running hash of the game state covers the same canonical form that the
+// LRU cache compares, so both backends see the same symmetries. Zero marks an
+// empty slot, so is never used
+uint64_t transposition_table::fingerprint(const game_state& gs) {
+    uint64_t h = gs.get_hash();
+    return h == 0 ? 1 : h;
+}
+
+uint64_t transposition_table::index_of(uint64_t fp) const {
+    return fp >> index_shift;
+}
+
+void transposition_table::allocate(uint64_t count) {
+    void* mem = nullptr;
+    if (posix_memalign(&mem, alignof(bucket), count * sizeof(bucket)) != 0)
+        throw bad_alloc();
+    if (huge_pages) arena::advise_huge_pages(mem, count * sizeof(bucket));
+    memset(mem, 0, count * sizeof(bucket));
+
+    buckets = static_cast<bucket*>(mem);
+    bucket_mask = count - 1;
+    index_shift = 64;
+    while (count > 1) { count /= 2; index_shift--; }
+}
+
+// Doubles the number of buckets and reinserts every fingerprint. Handles are
+// fingerprints, so they remain valid
+void transposition_table::grow() {
+    bucket* old_buckets = buckets;
+    uint64_t old_count = bucket_mask + 1;
+    allocate(old_count * 2);
+
+    for (uint64_t i = 0; i < old_count; i++) {
+        const bucket& ob = old_buckets[i];
+
+        for (uint8_t s = 0; s < bucket_slots; s++) {
+            uint64_t fp = ob.fingerprints[s];
+            if (fp == 0) continue;
+
+            bool placed = false;
+            for (uint64_t w = 0; w < probe_window && !placed; w++) {
+                bucket& b = buckets[(index_of(fp) + w) & bucket_mask];
+
+                for (uint8_t t = 0; t < bucket_slots && !placed; t++) {
+                    if (b.fingerprints[t] != 0) continue;
+                    b.fingerprints[t] = fp;
+                    if (ob.live & (1u << s)) b.live |= uint8_t(1u << t);
+                    placed = true;
+                }
+            }
+
+            // With twice the room, a state can only be dropped if its whole
+            // window has filled up. Live states must be kept though
+            if (!placed) {
+                if (ob.live & (1u << s)) {
+                    free(old_buckets);
+                    throw runtime_error("All items in cache are live and cache is full");
+                }
+                item_count--;
+                states_removed_from_cache++;
+            }
+        }
+    }
+    free(old_buckets);
+}
+
+// Looks for a fingerprint in its window. An empty slot ends the search, as
+// slots are only ever overwritten, never emptied, so no state can have been
+// placed beyond it
+bool transposition_table::find(uint64_t fp, bucket*& b_out, uint8_t& slot_out) const {
+    for (uint64_t w = 0; w < probe_window; w++) {
+        bucket& b = buckets[(index_of(fp) + w) & bucket_mask];
+
+        for (uint8_t s = 0; s < bucket_slots; s++) {
+            if (b.fingerprints[s] == fp) {
+                b_out = &b;
+                slot_out = s;
+                return true;
+            }
+            if (b.fingerprints[s] == 0) return false;
+        }
+    }
+    return false;
+}
+
+pair<state_cache::handle, bool> transposition_table::insert(const game_state& gs) {
+    uint64_t fp = fingerprint(gs);
+
+    // Grows once three quarters of the slots are taken
+    if (bucket_mask + 1 < max_bucket_count && (item_count + 1) * 4 > (bucket_mask + 1) * bucket_slots * 3) {
+        grow();
+    }
+
+    for (;;) {
+        bucket* victim = nullptr;
+        uint8_t victim_slot = 0;
+        uint64_t slots_scanned = 0, victim_scan_length = 0;
+
+        for (uint64_t w = 0; w < probe_window; w++) {
+            bucket& b = buckets[(index_of(fp) + w) & bucket_mask];
+
+            for (uint8_t s = 0; s < bucket_slots; s++) {
+                slots_scanned++;
+                if (b.fingerprints[s] == fp) {
+                    return make_pair(fp, false);
+                }
+                if (b.fingerprints[s] == 0) {
+                    b.fingerprints[s] = fp;
+                    b.live |= uint8_t(1u << s);
+                    item_count++;
+                    return make_pair(fp, true);
+                }
+                if (!victim && !(b.live & (1u << s))) {
+                    victim = &b;
+                    victim_slot = s;
+                    victim_scan_length = slots_scanned;
+                }
+            }
+        }
+
+        // The window is full. If the table can still grow, does so rather
+        // than losing a state
+        if (bucket_mask + 1 < max_bucket_count) {
+            grow();
+            continue;
+        }
+
+        if (!victim) {
+#ifndef NDEBUG
+            LOG_ERROR("All items in cache are live and cache is full");
+#endif
+            throw runtime_error("All items in cache are live and cache is full");
+        }
+
+        victim->fingerprints[victim_slot] = fp;
+        victim->live |= uint8_t(1u << victim_slot);
+        states_removed_from_cache++;
+        evict_stats.record(victim_scan_length);
+        return make_pair(fp, true);
+    }
+}
+
+bool transposition_table::contains(const game_state& gs) const {
+    bucket* b;
+    uint8_t s;
+    return find(fingerprint(gs), b, s);
+}
+
+void transposition_table::clear() {
+    memset(buckets, 0, (bucket_mask + 1) * sizeof(bucket));
+    item_count = 0;
+}
+
+uint64_t transposition_table::size() const {
+    return item_count;
+}
+
+uint64_t transposition_table::bucket_count() const {
+    return bucket_mask + 1;
+}
+
+// The table has no room to keep subtree sizes, so replaces any non-live state
+void transposition_table::set_non_live(handle fp, uint64_t) {
+    bucket* b = nullptr;
+    uint8_t s = 0;
+#ifndef NDEBUG
+    bool found =
+#endif
+    find(fp, b, s);
+    assert(found);
+    b->live &= uint8_t(~(1u << s));
+}
+
+uint64_t transposition_table::get_states_removed_from_cache() const {
+    return states_removed_from_cache;
+}
+
+uint64_t transposition_table::bytes_used() const {
+    return (bucket_mask + 1) * sizeof(bucket);
+}
+
+// The table never shrinks, so its peak size is its current size
+uint64_t transposition_table::peak_bytes_used() const {
+    return bytes_used();
+}
+
+uint64_t transposition_table::get_dead_state_count() const {
+    return 0;
+}
+
+uint64_t transposition_table::get_dead_state_hits() const {
+    return 0;
+}
+
+state_cache::eviction_stats transposition_table::get_eviction_stats() const {
+    return evict_stats;
+}
+
+
+////////////////////////////////
+// SHARED TRANSPOSITION TABLE //
+////////////////////////////////
+
+shared_transposition_table::shared_transposition_table(const game_state&, uint64_t max_num_items_, uint64_t max_bytes,
+                                                       bool huge_pages)
+        : max_num_items(max_num_items_)
+        , buckets(nullptr)
+        , allocation(nullptr)
+        , bucket_mask(0)
+        , index_shift(64)
+        , item_count(0)
+        , states_removed_from_cache(0)
+        , evict_scans(0)
+        , evict_total_scan_length(0)
+        , evict_max_scan_length(0) {
+    uint64_t count = min_bucket_count;
+    while (count * bucket_slots < max_num_items) count *= 2;
+    while (max_bytes > 0 && count > min_bucket_count && count * sizeof(bucket) > max_bytes) count /= 2;
+
+    // Zeroed memory is an empty table. Large blocks come straight from the
+    // OS, so pages are only committed once a state is written to them
+    allocation = calloc(count * sizeof(bucket) + alignof(bucket), 1);
+    if (!allocation) throw bad_alloc();
+    auto addr = reinterpret_cast<uintptr_t>(allocation);
+    addr = (addr + alignof(bucket) - 1) & ~uintptr_t(alignof(bucket) - 1);
+    buckets = new (reinterpret_cast<void*>(addr)) bucket[count];
+    if (huge_pages) arena::advise_huge_pages(buckets, count * sizeof(bucket));
+
+    bucket_mask = count - 1;
+    while (count > 1) { count /= 2; index_shift--; }
+}
+
+shared_transposition_table::~shared_transposition_table() {
+    free(allocation);
+}
+
+// The lowest bit of a slot is its live marker, so is not part of the
+// fingerprint. Zero marks an empty slot, so is never used
+uint64_t shared_transposition_table::fingerprint(const game_state& gs) {
+    uint64_t fp = gs.get_hash() & ~live_bit;
+    return fp == 0 ? 2 : fp;
+}
+
+shared_transposition_table::slot& shared_transposition_table::slot_at(uint64_t b, uint8_t s) const {
+    return buckets[b & bucket_mask].slots[s];
+}
+
+void shared_transposition_table::record_eviction(uint64_t scan_length) {
+    evict_scans.fetch_add(1, std::memory_order_relaxed);
+    evict_total_scan_length.fetch_add(scan_length, std::memory_order_relaxed);
+
+    uint64_t cur_max = evict_max_scan_length.load(std::memory_order_relaxed);
+    while (scan_length > cur_max
+           && !evict_max_scan_length.compare_exchange_weak(cur_max, scan_length, std::memory_order_relaxed));
+}
+
+// Claims an empty slot in the state's window, or failing that replaces a state
+// that no solver has live. A failed compare-and-swap means another solver got
+// to the slot first, in which case the slot is checked again, as it may now
+// hold the same state
+pair<state_cache::handle, bool> shared_transposition_table::insert(const game_state& gs) {
+    const uint64_t fp = fingerprint(gs);
+    const uint64_t home = fp >> index_shift;
+
+    for (;;) {
+        slot* victim = nullptr;
+        uint64_t victim_word = 0, victim_handle = 0, victim_scan_length = 0;
+        uint64_t slots_scanned = 0;
+
+        for (uint64_t w = 0; w < probe_window; w++) {
+            for (uint8_t s = 0; s < bucket_slots; s++) {
+                slot& sl = slot_at(home + w, s);
+                uint64_t h = ((home + w) & bucket_mask) * bucket_slots + s;
+                uint64_t word = sl.load();
+                slots_scanned++;
+
+                if (word == 0) {
+                    if (sl.compare_exchange_strong(word, fp | live_bit)) {
+                        item_count.fetch_add(1, std::memory_order_relaxed);
+                        return make_pair(h, true);
+                    }
+                }
+                if ((word & ~live_bit) == fp) {
+                    return make_pair(h, false);
+                }
+                if (!victim && !(word & live_bit)) {
+                    victim = &sl;
+                    victim_word = word;
+                    victim_handle = h;
+                    victim_scan_length = slots_scanned;
+                }
+            }
+        }
+
+        if (!victim) {
+#ifndef NDEBUG
+            LOG_ERROR("All items in cache are live and cache is full");
+#endif
+            throw runtime_error("All items in cache are live and cache is full");
+        }
+
+        if (victim->compare_exchange_strong(victim_word, fp | live_bit)) {
+            states_removed_from_cache.fetch_add(1, std::memory_order_relaxed);
+            record_eviction(victim_scan_length);
+            return make_pair(victim_handle, true);
+        }
+    }
+}
+
+bool shared_transposition_table::contains(const game_state& gs) const {
+    const uint64_t fp = fingerprint(gs);
+    const uint64_t home = fp >> index_shift;
+
+    for (uint64_t w = 0; w < probe_window; w++) {
+        for (uint8_t s = 0; s < bucket_slots; s++) {
+            uint64_t word = slot_at(home + w, s).load();
+            if ((word & ~live_bit) == fp) return true;
+            if (word == 0) return false;
+        }
+    }
+    return false;
+}
+
+// Must not be called while any solver is using the table
+void shared_transposition_table::clear() {
+    for (uint64_t b = 0; b <= bucket_mask; b++) {
+        for (uint8_t s = 0; s < bucket_slots; s++) {
+            slot_at(b, s).store(0, std::memory_order_relaxed);
+        }
+    }
+    item_count = 0;
+}
+
+uint64_t shared_transposition_table::size() const {
+    return item_count.load(std::memory_order_relaxed);
+}
+
+uint64_t shared_transposition_table::bucket_count() const {
+    return bucket_mask + 1;
+}
+
+// Only the solver that inserted a state holds its handle, and a live state is
+// never replaced, so the slot must still hold the state
+void shared_transposition_table::set_non_live(handle h, uint64_t) {
+#ifndef NDEBUG
+    uint64_t word =
+#endif
+    slot_at(h / bucket_slots, uint8_t(h % bucket_slots)).fetch_and(~live_bit);
+    assert(word & live_bit);
+}
+
+uint64_t shared_transposition_table::get_states_removed_from_cache() const {
+    return states_removed_from_cache.load(std::memory_order_relaxed);
+}
+
+uint64_t shared_transposition_table::bytes_used() const {
+    return (bucket_mask + 1) * sizeof(bucket);
+}
+
+// The whole table is allocated up front
+uint64_t shared_transposition_table::peak_bytes_used() const {
+    return bytes_used();
+}
+
+uint64_t shared_transposition_table::get_dead_state_count() const {
+    return 0;
+}
+
+uint64_t shared_transposition_table::get_dead_state_hits() const {
+    return 0;
+}
+
+state_cache::eviction_stats shared_transposition_table::get_eviction_stats() const {
+    return eviction_stats{evict_scans.load(std::memory_order_relaxed),
+                          evict_total_scan_length.load(std::memory_order_relaxed),
+                          evict_max_scan_length.load(std::memory_order_relaxed)};
+}
+
+///////////////////
+// CACHE OPTIONS //
+///////////////////
+
+cache_options::cache_options(uint64_t capacity_, state_cache::backend type_,
+                             state_cache::eviction_policy eviction_, uint64_t memory_, bool huge_pages_,
+                             bool dead_states_)
+        : capacity(capacity_), type(type_), eviction(eviction_), memory(memory_), huge_pages(huge_pages_)
+        , dead_states(dead_states_) {
+}
+
+std::shared_ptr<state_cache> make_state_cache(const game_state& gs, const cache_options& opts) {
+    switch (opts.type) {
+        case state_cache::backend::TRANSPOSITION_TABLE:
+            return std::make_shared<transposition_table>(gs, opts.capacity, opts.memory, opts.huge_pages);
+        case state_cache::backend::SHARED_TRANSPOSITION_TABLE:
+            return std::make_shared<shared_transposition_table>(gs, opts.capacity, opts.memory, opts.huge_pages);
+        case state_cache::backend::LRU:
+        default:
+            return std::make_shared<lru_cache>(gs, opts.capacity, opts.eviction, opts.memory, opts.huge_pages,
+                                               opts.dead_states);
+    }
+}
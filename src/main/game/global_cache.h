@@ -25,44 +25,163 @@
 #define SOLVITAIRE_GLOBAL_CACHE_H
 
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <unordered_set>
-#include <boost/pool/pool.hpp>
-#include <boost/pool/pool_alloc.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include "arena.h"
 #include "sol_rules.h"
 #include "search-state/game_state.h"
 
-struct cached_game_state {
-    typedef std::vector<card> state_data;
-    typedef state_data::size_type size_type;
+// How a cached state is packed into a fixed number of 64-bit words. Each card
+// (or pile divider) is a symbol of the smallest width that fits every card the
+// rules allow, after suit reduction, and the key is long enough for a full
+// deal plus every divider
+struct state_key_format {
+    typedef uint64_t word;
+
+    explicit state_key_format(const game_state&);
+    uint8_t symbol(card) const;
 
-    explicit cached_game_state(const game_state&);
-    void add_pile(pile::ref, const game_state&);
-    void add_pile_in_reverse(pile::ref, const game_state&);
-    void add_card(card, const game_state&);
-    void add_card_divider();
+    uint8_t bits_per_symbol;
+    uint16_t words;
+    uint64_t bytes() const;
+
+private:
+    enum class suit_reduction { NONE, COLOUR, ALL };
 
-    state_data data;
-    bool live; // Is a parent in the current search tree
+    suit_reduction reduction;
+    uint8_t max_rank;
+    bool face_down_possible;
 };
 
-bool operator==(const cached_game_state&, const cached_game_state&);
+struct cached_game_state {
+    typedef state_key_format::word word;
+
+    // Packs the state into the given storage, which must hold a whole key
+    cached_game_state(const game_state&, const state_key_format&, word*);
+
+    word* data;              // The packed key. Its storage is owned by the cache
+    uint64_t hash;           // The running hash of the game state it was built from
+    bool live;               // Is a parent in the current search tree
+    mutable bool referenced; // Has been looked up since the clock hand last passed
+    mutable uint8_t credit;  // Passes of the eviction scan it survives, from the size of its subtree
+
+private:
+    class key_writer;
+};
 
 struct hasher {
-    explicit hasher(const game_state&);
+    explicit hasher(const state_key_format&);
     std::size_t operator() (const cached_game_state&) const;
+    std::size_t full_hash(const cached_game_state&) const;
+
+    uint16_t words;
+};
+
+struct key_equal {
+    explicit key_equal(const state_key_format&);
+    bool operator() (const cached_game_state&, const cached_game_state&) const;
+
+    uint16_t words;
+};
+
+// The interface the solver uses to record visited states. A handle identifies
+// a cached state for as long as it is 'live' (i.e. a parent in the current
+// search tree), as live states are never evicted. When a state stops being
+// live, the solver passes the number of states it searched beneath it
+class state_cache {
+public:
+    typedef uint64_t handle;
+    enum class backend { LRU, TRANSPOSITION_TABLE, SHARED_TRANSPOSITION_TABLE };
+    enum class eviction_policy { LRU, CLOCK, COST };
+
+    // How many entries were looked at to find each state to evict
+    struct eviction_stats {
+        uint64_t scans;
+        uint64_t total_scan_length;
+        uint64_t max_scan_length;
+
+        void record(uint64_t);
+    };
+
+    virtual ~state_cache() = default;
+
+    virtual std::pair<handle, bool> insert(const game_state&) = 0;
+    virtual bool contains(const game_state&) const = 0;
+    virtual void clear() = 0;
+    virtual uint64_t size() const = 0;
+    virtual uint64_t bucket_count() const = 0;
+    virtual void set_non_live(handle, uint64_t) = 0;
+    virtual uint64_t get_states_removed_from_cache() const = 0;
+    virtual uint64_t bytes_used() const = 0;
+    virtual uint64_t peak_bytes_used() const = 0;
+    virtual eviction_stats get_eviction_stats() const = 0;
+    virtual uint64_t get_dead_state_count() const = 0;
+    virtual uint64_t get_dead_state_hits() const = 0;
+};
+
+struct cache_options {
+    explicit cache_options(uint64_t = 100000000,
+                           state_cache::backend = state_cache::backend::LRU,
+                           state_cache::eviction_policy = state_cache::eviction_policy::LRU,
+                           uint64_t = 0,
+                           bool = false,
+                           bool = false);
+
+    uint64_t capacity;
+    state_cache::backend type;
+    state_cache::eviction_policy eviction;
+    uint64_t memory; // An upper bound on the bytes used by the cache, or zero for none
+    bool huge_pages; // Back the cache with transparent huge pages
+    bool dead_states; // Remember the fingerprints of evicted states
+};
+
+std::shared_ptr<state_cache> make_state_cache(const game_state&, const cache_options&);
+
+// The fingerprints of states that have been evicted from the LRU cache. Only
+// states that have been searched in full are ever evicted, so a state found
+// here is known to lead nowhere new. Nothing is removed, and each state takes
+// a single 64-bit slot in a flat open-addressing table. As only the
+// fingerprint is kept, a collision could (very rarely) prune a state that was
+// never searched, and so make a solvable deal look unsolvable
+class dead_state_set {
+public:
+    explicit dead_state_set(uint64_t = 0);
+
+    bool insert(uint64_t);
+    bool contains(uint64_t) const;
+    uint64_t size() const;
+    uint64_t bytes_used() const;
+
+private:
+    static const uint64_t min_slot_count = 1024;
 
-    std::size_t hash_value(const card&) const;
-    std::size_t combine(std::size_t&, std::size_t) const;
+    uint64_t index_of(uint64_t) const;
+    void grow();
 
-    const game_state& init_gs;
+    std::vector<uint64_t> slots; // Zero marks an empty slot
+    uint64_t slot_mask;
+    uint8_t index_shift;
+    uint64_t item_count;
+    uint64_t max_bytes;
 };
 
-class lru_cache {
+// Keeps full packed states, evicting non-live states when it is full. With the
+// LRU policy, a looked up state is moved to the front and states are evicted
+// from the back, passing over live ones. With the CLOCK policy, live states
+// are kept out of the clock's ring entirely, so the hand only has to skip
+// states that have been looked up since it last passed them. The COST policy
+// is LRU, but a state whose subtree was expensive to search is given credit
+// for the log of its size, and is moved back to the front that many times
+// before it is evicted.
+// The container and the packed keys all live in one arena, and none of them
+// need destructing, so the whole cache is freed at once when it is destroyed
+class lru_cache : public state_cache {
 public:
     typedef boost::multi_index::multi_index_container<
             cached_game_state,
@@ -70,26 +189,171 @@ public:
                     boost::multi_index::sequenced<>,
                     boost::multi_index::hashed_unique<
                             boost::multi_index::identity<cached_game_state>,
-                            hasher
+                            hasher,
+                            key_equal
                     >
-            >
+            >,
+            arena_allocator<cached_game_state>
     > item_list;
 
-    explicit lru_cache(const game_state&, uint64_t);
-    std::pair<item_list::iterator, bool> insert(const game_state&);
-    bool contains(const game_state&) const;
-    void clear();
-    item_list::size_type size() const;
-    item_list::size_type bucket_count() const;
-    void set_non_live(item_list::iterator);
-    uint64_t get_states_removed_from_cache() const;
+    explicit lru_cache(const game_state&, uint64_t, eviction_policy = eviction_policy::LRU, uint64_t = 0,
+                       bool = false, bool = false);
+    lru_cache(const lru_cache&) = delete;
+    lru_cache& operator=(const lru_cache&) = delete;
+
+    std::pair<handle, bool> insert(const game_state&) override;
+    bool contains(const game_state&) const override;
+    void clear() override;
+    uint64_t size() const override;
+    uint64_t bucket_count() const override;
+    void set_non_live(handle, uint64_t) override;
+    uint64_t get_states_removed_from_cache() const override;
+    uint64_t bytes_used() const override;
+    uint64_t peak_bytes_used() const override;
+    eviction_stats get_eviction_stats() const override;
+    uint64_t get_dead_state_count() const override;
+    uint64_t get_dead_state_hits() const override;
+
+private:
+    static item_list::ctor_args_list get_init_tuple(const state_key_format&);
+
+    static const uint8_t max_credit = 15;
+
+    bool is_full() const;
+
+    void evict_lru();
+    void evict_clock();
+    void evict_cost();
+    void remove(item_list::iterator);
+    item_list::iterator clock_hand();
+
+    uint64_t max_num_items;
+    uint64_t max_bytes;
+    uint64_t peak_bytes;
+    state_key_format key_format;
+    arena mem;
+    item_list& cache;
+    mutable std::vector<cached_game_state::word> probe_key;
+    uint64_t states_removed_from_cache;
+    eviction_policy eviction;
+    eviction_stats evict_stats;
+    std::unique_ptr<dead_state_set> dead_states;
+    uint64_t dead_state_hits;
+
+    // With the CLOCK policy, the list holds the ring of non-live states
+    // followed by all live ones. The hand points into the ring, or at the
+    // first live state once it has passed the end of the ring
+    item_list::iterator hand;
+};
+
+// An open-addressing table of 64-bit state fingerprints. Buckets are a single
+// cache line each, and a state is looked for in a short window of consecutive
+// buckets. Unlike the LRU cache, the full state is never stored, so a
+// fingerprint collision could (very rarely) prune an unseen state
+class transposition_table : public state_cache {
+public:
+    explicit transposition_table(const game_state&, uint64_t, uint64_t = 0, bool = false);
+    ~transposition_table() override;
+    transposition_table(const transposition_table&) = delete;
+    transposition_table& operator=(const transposition_table&) = delete;
+
+    std::pair<handle, bool> insert(const game_state&) override;
+    bool contains(const game_state&) const override;
+    void clear() override;
+    uint64_t size() const override;
+    uint64_t bucket_count() const override;
+    void set_non_live(handle, uint64_t) override;
+    uint64_t get_states_removed_from_cache() const override;
+    uint64_t bytes_used() const override;
+    uint64_t peak_bytes_used() const override;
+    eviction_stats get_eviction_stats() const override;
+    uint64_t get_dead_state_count() const override;
+    uint64_t get_dead_state_hits() const override;
+
+    static uint64_t fingerprint(const game_state&);
 
 private:
-    static item_list::ctor_args_list get_init_tuple(const game_state&);
+    static const uint8_t bucket_slots = 7;
+    static const uint8_t probe_window = 4;
+    static const uint64_t min_bucket_count = 1024;
+
+    struct alignas(64) bucket {
+        uint64_t fingerprints[bucket_slots]; // Zero marks an empty slot
+        uint8_t live;                        // Bit i is set if slot i is live
+        uint8_t unused[7];
+    };
+
+    uint64_t index_of(uint64_t) const;
+    bool find(uint64_t, bucket*&, uint8_t&) const;
+    void allocate(uint64_t);
+    void grow();
 
     uint64_t max_num_items;
-    item_list cache;
+    uint64_t max_bucket_count;
+    bool huge_pages;
+    bucket* buckets;
+    uint64_t bucket_mask;
+    uint8_t index_shift;
+    uint64_t item_count;
     uint64_t states_removed_from_cache;
+    eviction_stats evict_stats;
+};
+
+// A transposition table that several solvers searching the same deal can use
+// at once, so that no state is searched by more than one of them. It is
+// lock-free: each slot is a single atomic word holding a fingerprint in its
+// upper bits and the 'live' marker in its lowest bit, so a state is claimed,
+// released or replaced with one compare-and-swap. The table is allocated at
+// its full size up front, as it cannot be rehashed while it is being searched.
+// A handle is the index of the state's slot, so it stays with the solver that
+// inserted the state even if a race has placed the same fingerprint twice
+class shared_transposition_table : public state_cache {
+public:
+    explicit shared_transposition_table(const game_state&, uint64_t, uint64_t = 0, bool = false);
+    ~shared_transposition_table() override;
+    shared_transposition_table(const shared_transposition_table&) = delete;
+    shared_transposition_table& operator=(const shared_transposition_table&) = delete;
+
+    std::pair<handle, bool> insert(const game_state&) override;
+    bool contains(const game_state&) const override;
+    void clear() override;
+    uint64_t size() const override;
+    uint64_t bucket_count() const override;
+    void set_non_live(handle, uint64_t) override;
+    uint64_t get_states_removed_from_cache() const override;
+    uint64_t bytes_used() const override;
+    uint64_t peak_bytes_used() const override;
+    eviction_stats get_eviction_stats() const override;
+    uint64_t get_dead_state_count() const override;
+    uint64_t get_dead_state_hits() const override;
+
+    static uint64_t fingerprint(const game_state&);
+
+private:
+    typedef std::atomic<uint64_t> slot;
+
+    static const uint8_t bucket_slots = 8;
+    static const uint8_t probe_window = 4;
+    static const uint64_t min_bucket_count = 1024;
+    static const uint64_t live_bit = 1;
+
+    struct alignas(64) bucket {
+        slot slots[bucket_slots]; // Zero marks an empty slot
+    };
+
+    slot& slot_at(uint64_t, uint8_t) const;
+    void record_eviction(uint64_t);
+
+    uint64_t max_num_items;
+    bucket* buckets;
+    void* allocation;
+    uint64_t bucket_mask;
+    uint8_t index_shift;
+    std::atomic<uint64_t> item_count;
+    std::atomic<uint64_t> states_removed_from_cache;
+    std::atomic<uint64_t> evict_scans;
+    std::atomic<uint64_t> evict_total_scan_length;
+    std::atomic<uint64_t> evict_max_scan_length;
 };
 
 #endif //SOLVITAIRE_GLOBAL_CACHE_H
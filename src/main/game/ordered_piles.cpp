@@ -0,0 +1,72 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <algorithm>
+#include <cassert>
+
+#include "ordered_piles.h"
+
+ordered_piles::ordered_piles() : refs(), count(0) {
+}
+
+ordered_piles::const_iterator ordered_piles::begin() const {
+    return refs.begin();
+}
+
+ordered_piles::const_iterator ordered_piles::end() const {
+    return refs.begin() + count;
+}
+
+ordered_piles::size_type ordered_piles::size() const {
+    return count;
+}
+
+bool ordered_piles::empty() const {
+    return count == 0;
+}
+
+pile::ref ordered_piles::front() const {
+    assert(!empty());
+    return refs[0];
+}
+
+pile::ref ordered_piles::back() const {
+    assert(!empty());
+    return refs[count - 1];
+}
+
+pile::ref ordered_piles::operator[](size_type i) const {
+    assert(i < count);
+    return refs[i];
+}
+
+void ordered_piles::push_back(pile::ref pr) {
+    assert(count < refs.size());
+    refs[count++] = pr;
+}
+
+void ordered_piles::reposition(size_type from, size_type to) {
+    assert(from < count && to < count);
+    if (from < to) {
+        std::rotate(refs.begin() + from, refs.begin() + from + 1, refs.begin() + to + 1);
+    } else {
+        std::rotate(refs.begin() + to, refs.begin() + from, refs.begin() + from + 1);
+    }
+}
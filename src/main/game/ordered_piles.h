@@ -0,0 +1,59 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_ORDERED_PILES_H
+#define SOLVITAIRE_ORDERED_PILES_H
+
+#include <array>
+
+#include "pile.h"
+
+// The refs of one class of interchangeable piles (the tableau piles, cells or
+// reserve), in the order the game state keeps them in for pile symmetry. The
+// refs are held inline, so copying a state doesn't allocate, and a pile is
+// repositioned by shifting its neighbours along, as in an insertion sort
+class ordered_piles {
+public:
+    typedef uint8_t size_type;
+    // A pile ref of 255 means no pile, so there are never more piles than that
+    static constexpr size_type capacity = 255;
+    typedef std::array<pile::ref, capacity>::const_iterator const_iterator;
+
+    ordered_piles();
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    size_type size() const;
+    bool empty() const;
+    pile::ref front() const;
+    pile::ref back() const;
+    pile::ref operator[](size_type) const;
+
+    void push_back(pile::ref);
+    // Moves the ref at the first index to the second, shifting the refs in
+    // between along by one
+    void reposition(size_type, size_type);
+
+private:
+    std::array<pile::ref, capacity> refs;
+    size_type count;
+};
+
+#endif //SOLVITAIRE_ORDERED_PILES_H
@@ -22,90 +22,171 @@
 //
 
 #include <vector>
+#include <algorithm>
 #include <ostream>
+#include <stdexcept>
 
 #include "pile.h"
 
 using namespace std;
 
 const pile::size_type pile::max_size_type = 255;
+const pile::size_type pile::key_cards = 9;
 
-pile::pile(std::vector<card> pv) : pile_vec(pv) {
+constexpr pile::size_type pile::capacity;
+
+pile::pile() : order_key(0), card_count(0), face_down_cards(0) {
+}
+
+pile::pile(std::vector<card> pv) : pile() {
+    for (card c : pv) place(c);
 }
 
-pile::pile(std::initializer_list<card> il) : pile_vec(il) {
+pile::pile(std::initializer_list<card> il) : pile() {
+    for (card c : il) place(c);
 }
 
 card pile::top_card() const {
     assert(!empty());
-    return pile_vec.back();
+    return cards[card_count - 1];
 }
 
 bool pile::empty() const {
-    return pile_vec.empty();
+    return card_count == 0;
 }
 
 pile::size_type pile::size() const {
-    return static_cast<uint8_t>(pile_vec.size());
+    return card_count;
 }
 
-card& pile::operator[] (size_type i) {
-    return pile_vec[pile_vec.size() - 1 - i];
+card pile::operator[] (size_type i) const {
+    assert(i < card_count);
+    return cards[card_count - 1 - i];
 }
 
-card pile::operator[] (size_type i) const {
-    vector<card>::size_type s = pile_vec.size() - 1 - i;
-    assert(s < pile_vec.size());
-    return pile_vec[s];
+pile::size_type pile::built_group_height() const {
+    assert(!empty());
+    return runs[card_count - 1].built_group;
 }
 
-void pile::place(const card c) {
-    pile_vec.emplace_back(c);
+pile::size_type pile::face_down_count() const {
+    return face_down_cards;
+}
+
+bool pile::is_ordered(card::rank_t max_rank) const {
+    return size() == max_rank
+           && runs[card_count - 1].ordered == max_rank
+           && top_card().get_rank() == 1;
+}
+
+void pile::place(const card c, bool extends_built_group) {
+    if (size() < key_cards) order_key |= key_bits(size(), c);
+    // The cards are held inline, so a pile can't grow past its capacity
+    if (card_count == capacity) throw runtime_error("a pile cannot hold more than 104 cards");
+    order_key += uint64_t(1) << 56;
+    runs[card_count] = heights_on(card_count, c, extends_built_group);
+    cards[card_count++] = c;
+    face_down_cards += c.is_face_down();
 }
 
 card pile::take() {
     assert(!empty());
-    card c = top_card();
-    pile_vec.pop_back();
+    card c = cards[--card_count];
+    face_down_cards -= c.is_face_down();
+    order_key -= uint64_t(1) << 56;
+    if (size() < key_cards) order_key &= ~key_slot(size());
     return c;
 }
 
+// Replaces the card at the given index. The runs of the cards above it are
+// left for the caller to re-evaluate, as they may depend on the game's rules
+void pile::set(size_type i, const card c, bool extends_built_group) {
+    if (i >= card_count) throw out_of_range("no card at that index of the pile");
+    auto s = size_type(card_count - 1 - i);
+
+    face_down_cards -= cards[s].is_face_down();
+    face_down_cards += c.is_face_down();
+    cards[s] = c;
+    runs[s] = heights_on(s, c, extends_built_group);
+    if (s < key_cards) {
+        order_key &= ~key_slot(s);
+        order_key |= key_bits(s, c);
+    }
+}
+
+// The bits of the order key for a card at the given position from the bottom
+// of the pile. The size takes the top byte, and each card six bits below it,
+// bottom card first
+uint64_t pile::key_bits(size_type pos, const card c) {
+    return uint64_t(c.get_rank() << 2 | c.get_suit()) << (50 - 6 * pos);
+}
+
+uint64_t pile::key_slot(size_type pos) {
+    return uint64_t(63) << (50 - 6 * pos);
+}
+
+// The run heights of a card at the given position from the bottom of the pile,
+// given the runs of the cards below it
+pile::run_heights pile::heights_on(size_type pos, const card c, bool extends_built_group) const {
+    if (pos == 0) return {1, 1};
+
+    const card below = cards[pos - 1];
+    const run_heights& below_heights = runs[pos - 1];
+
+    bool extends_ordered = below.get_suit() == c.get_suit()
+                           && below.get_rank() == c.get_rank() + 1;
+
+    return {
+            size_type(extends_built_group ? below_heights.built_group + 1 : 1),
+            size_type(extends_ordered ? below_heights.ordered + 1 : 1)
+    };
+}
+
+// Compares the cards of two piles of the same size above those in their
+// order keys, bottom card first
+bool pile::cards_less(const pile& a, const pile& b) {
+    assert(a.size() == b.size());
+    return std::lexicographical_compare(begin(a.cards) + key_cards, begin(a.cards) + a.card_count,
+                                        begin(b.cards) + key_cards, begin(b.cards) + b.card_count);
+}
+
 bool operator==(const pile& a, const pile& b) {
-    return a.pile_vec == b.pile_vec;
+    return a.card_count == b.card_count
+           && std::equal(begin(a.cards), begin(a.cards) + a.card_count, begin(b.cards));
 }
 
 bool operator!=(const pile& a, const pile& b) {
-    return a.pile_vec != b.pile_vec;
+    return !(a == b);
 }
 
 bool operator<(const pile& a, const pile& b) {
-    if (a.size() == b.size()) {
-        return a.pile_vec < b.pile_vec;
+    if (a.order_key != b.order_key || a.size() <= pile::key_cards) {
+        return a.order_key < b.order_key;
     } else {
-        return a.size() < b.size();
+        return pile::cards_less(a, b);
     }
 }
 
 bool operator>(const pile& a, const pile& b) {
-    if (a.size() == b.size()) {
-        return a.pile_vec > b.pile_vec;
+    if (a.order_key != b.order_key || a.size() <= pile::key_cards) {
+        return a.order_key > b.order_key;
     } else {
-        return a.size() > b.size();
+        return pile::cards_less(b, a);
     }
 }
 
 bool operator<=(const pile& a, const pile& b) {
-    if (a.size() == b.size()) {
-        return a.pile_vec <= b.pile_vec;
+    if (a.order_key != b.order_key || a.size() <= pile::key_cards) {
+        return a.order_key <= b.order_key;
     } else {
-        return a.size() <= b.size();
+        return !pile::cards_less(b, a);
     }
 }
 
 bool operator>=(const pile& a, const pile& b) {
-    if (a.size() == b.size()) {
-        return a.pile_vec >= b.pile_vec;
+    if (a.order_key != b.order_key || a.size() <= pile::key_cards) {
+        return a.order_key >= b.order_key;
     } else {
-        return a.size() >= b.size();
+        return !pile::cards_less(a, b);
     }
 }
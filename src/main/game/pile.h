@@ -25,6 +25,7 @@
 #define SOLVITAIRE_PILE_H
 
 #include <vector>
+#include <array>
 #include <iterator>
 
 #include "sol_rules.h"
@@ -38,8 +39,10 @@ public:
     typedef uint8_t size_type;
     const static size_type max_size_type;
     typedef uint8_t ref;
+    // The most cards a pile can hold: every card of two decks
+    static constexpr size_type capacity = 104;
 
-    pile() = default;
+    pile();
     pile(std::vector<card>);
     pile(std::initializer_list<card>);
 
@@ -49,9 +52,17 @@ public:
     size_type size() const;
 
     // Indexes the vector, with the top card as index 0
-    card& operator[] (size_type);
     card operator[] (size_type) const;
 
+    // Derived data, kept up to date as the pile changes rather than found by
+    // rescanning it. The built group is the run of face-up cards at the top
+    // of the pile each of which, by the game's rules, can be built on the
+    // one beneath it
+    size_type built_group_height() const;
+    size_type face_down_count() const;
+    // Whether the pile holds a whole suit in order, ace on top
+    bool is_ordered(card::rank_t) const;
+
     friend bool operator==(const pile&, const pile&);
     friend bool operator!=(const pile&, const pile&);
     friend bool operator<(const pile&, const pile&);
@@ -59,13 +70,39 @@ public:
     friend bool operator<=(const pile&, const pile&);
     friend bool operator>=(const pile&, const pile&);
 
-    // Modify
-    void place(card);
+    // Modify. The flag says whether the card extends the built group beneath it
+    void place(card, bool = false);
     card take();
+    void set(size_type, card, bool = false);
 
 private:
-    // Underlying vector
-    std::vector<card> pile_vec;
+    // The heights of the runs ending at a card, were it the top card
+    struct run_heights {
+        size_type built_group;
+        size_type ordered;
+    };
+
+    run_heights heights_on(size_type, card, bool) const;
+
+    // The order key holds the pile's size and the cards at the bottom of it,
+    // laid out so that comparing keys orders piles the same way as comparing
+    // them in full. Only piles with equal keys, above the key's cards, need
+    // their cards compared
+    static const size_type key_cards;
+    static uint64_t key_bits(size_type, card);
+    static uint64_t key_slot(size_type);
+    static bool cards_less(const pile&, const pile&);
+
+    // The counts come first, so that they share a cache line with the cards
+    // of most piles
+    uint64_t order_key;
+    size_type card_count;
+    size_type face_down_cards;
+    // The cards, bottom card first, held inline so that copying a pile (and
+    // so a game state) doesn't allocate
+    std::array<card, capacity> cards;
+    // Parallel to them
+    std::array<run_heights, capacity> runs;
 };
 
 
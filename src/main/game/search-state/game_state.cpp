@@ -25,6 +25,7 @@
 #include <ostream>
 #include <algorithm>
 #include <functional>
+#include <limits>
 
 #include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
@@ -67,10 +68,20 @@ typedef sol_rules::foundations_init_type fit;
 game_state::game_state(const sol_rules& s_rules, streamliner_options stream_opts_)
         : rules(s_rules)
         , stream_opts(stream_opts_)
+        , move_engine(pick_engine(s_rules))
         , foundations_base(card::rank_t(1))
         , stock(255)
         , waste(255)
-        , hole (255) {
+        , hole (255)
+        , foundation_cards(0)
+        , top_card_index(uses_top_card_index(s_rules))
+        , tableau_tops(0)
+        , tableau_top_piles()
+        , empty_tableau_piles(0)
+        , card_copies(card_location_copies(s_rules))
+        , card_locations(rules.max_rank * 4u * card_copies, card_location{255, 0}) {
+    init_card_relations();
+
     // If there is a hole, creates pile
     if (rules.hole) {
         piles.emplace_back();
@@ -131,6 +142,7 @@ game_state::game_state(const sol_rules& s_rules, streamliner_options stream_opts
         piles.emplace_back();
         tableau_piles.push_back(static_cast<pile::ref>(piles.size() - 1));
         original_tableau_piles.push_back(static_cast<pile::ref>(piles.size() - 1));
+        index_top_card(static_cast<pile::ref>(piles.size() - 1), true);
     }
 
     // Creates the sequence piles
@@ -138,6 +150,8 @@ game_state::game_state(const sol_rules& s_rules, streamliner_options stream_opts
         piles.emplace_back();
         sequences.push_back(static_cast<pile::ref>(piles.size() - 1));
     }
+
+    init_hash();
 }
 
 // Constructs an initial game state from a JSON doc
@@ -171,7 +185,7 @@ game_state::game_state(const sol_rules& s_rules, int seed, streamliner_options s
     card::suit_t rand_suit = 0;
     if (!rules.foundations_base) { 
 	card base_card = deck.front();
-        foundations_base = base_card.get_rank();
+        set_foundations_base(base_card.get_rank());
         rand_suit = base_card.get_suit();
     }
 
@@ -276,9 +290,9 @@ game_state::game_state(const sol_rules& s_rules, int seed, streamliner_options s
 
     // Now if necessary, turns the top cards face up
     if (rules.face_up == fu::TOP_CARDS)
-        for (auto& p : piles)
-            if (!p.empty())
-                p[0].turn_face_up();
+        for (pile::ref pr = 0; pr < piles.size(); pr++)
+            if (!piles[pr].empty())
+                turn_face_up(pr);
 
     // The size of all piles must equal the deck size
     int piles_sz = 0;
@@ -303,7 +317,7 @@ game_state::game_state(const sol_rules& s_rules,
     if (rules.foundations_present && rules.foundations_base == boost::none) {
         for (auto f : foundations) {
             if (!piles[f].empty()) {
-                foundations_base = piles[f].top_card().get_rank();
+                set_foundations_base(piles[f].top_card().get_rank());
                 return;
             }
         }
@@ -376,6 +390,7 @@ void game_state::make_move(const move m) {
 
 #ifndef NDEBUG
     check_face_down_consistent();
+    assert(get_hash() == compute_hash());
 #endif
 }
 
@@ -406,6 +421,7 @@ void game_state::undo_move(const move m) {
 
 #ifndef NDEBUG
     check_face_down_consistent();
+    assert(get_hash() == compute_hash());
 #endif
 }
 
@@ -418,7 +434,7 @@ void game_state::make_regular_move(const move m) {
     if (m.reveal_move) {
         assert(!piles[m.from].empty());
         assert(piles[m.from][0].is_face_down());
-        piles[m.from][0].turn_face_up();
+        turn_face_up(m.from);
     }
 
 }
@@ -429,7 +445,7 @@ void game_state::undo_regular_move(const move m) {
     if (m.reveal_move) {
         assert(!piles[m.from].empty());
         assert(!piles[m.from][0].is_face_down());
-        piles[m.from][0].turn_face_down();
+        turn_face_down(m.from);
     }
 
     place_card(m.from, take_card(m.to));
@@ -440,20 +456,12 @@ void game_state::make_built_group_move(move m) {
     assert(m.from  <  piles.size()  );
     assert(m.to    <  piles.size()  );
 
-    // Adds the cards to the 'to' pile
-    for (auto pile_idx = m.count; pile_idx-- > 0;) {
-        place_card(m.to, piles[m.from][pile_idx]);
-    }
-
-    // Removes the cards from the 'from' pile
-    for (uint8_t rem_count = 0; rem_count < m.count; rem_count++) {
-        take_card(m.from);
-    }
+    move_cards(m.from, m.to, pile::size_type(m.count));
 
     if (m.reveal_move) {
         assert(!piles[m.from].empty());
         assert(piles[m.from][0].is_face_down());
-        piles[m.from][0].turn_face_up();
+        turn_face_up(m.from);
     }
 }
 
@@ -463,17 +471,21 @@ void game_state::undo_built_group_move(move m) {
     if (m.reveal_move) {
         assert(!piles[m.from].empty());
         assert(!piles[m.from][0].is_face_down());
-        piles[m.from][0].turn_face_down();
+        turn_face_down(m.from);
     }
 
-    // Adds the cards to the 'from' pile
-    for (auto pile_idx = m.count; pile_idx-- > 0;) {
-        place_card(m.from, piles[m.to][pile_idx]);
-    }
+    move_cards(m.to, m.from, pile::size_type(m.count));
+}
 
-    // Removes the cards from the 'to' pile
-    for (uint8_t rem_count = 0; rem_count < m.count; rem_count++) {
-        take_card(m.to);
+// Moves the top cards of one pile onto another, keeping their order. Takes
+// them all before placing any, so a card is never in two places at once
+void game_state::move_cards(pile::ref from, pile::ref to, pile::size_type count) {
+    card moved[std::numeric_limits<pile::size_type>::max()];
+    for (pile::size_type i = 0; i < count; i++) {
+        moved[i] = take_card(from);
+    }
+    for (auto i = count; i-- > 0;) {
+        place_card(to, moved[i]);
     }
 }
 
@@ -573,28 +585,28 @@ void game_state::undo_stock_to_all_tableau_move(move m) {
     }
 }
 
+// Fills the gap before leaving one behind, so that there are never more gaps
+// than the card locations have room for
 void game_state::make_sequence_move(const move m) {
-    pile::ref from_seq_ref = m.from / rules.max_rank;
-    pile::size_type from_card_idx = m.from % rules.max_rank;
-    card from_card = piles[from_seq_ref][from_card_idx];
-    piles[from_seq_ref][from_card_idx] = "AS";
+    auto from = locate_sequence_card(m.from);
+    card from_card = piles[from.first][from.second];
+
+    auto to = locate_sequence_card(m.to);
+    assert(piles[to.first][to.second] == "AS");
+    set_card(to.first, to.second, from_card);
 
-    pile::ref to_seq_ref = m.to / rules.max_rank;
-    pile::size_type to_card_idx = m.to % rules.max_rank;
-    assert(piles[to_seq_ref][to_card_idx] == "AS");
-    piles[to_seq_ref][to_card_idx] = from_card;
+    set_card(from.first, from.second, "AS");
 }
 
 void game_state::undo_sequence_move(const move m) {
-    pile::ref to_seq_ref = m.to / rules.max_rank;
-    pile::size_type to_card_idx = m.to % rules.max_rank;
-    card to_card = piles[to_seq_ref][to_card_idx];
-    piles[to_seq_ref][to_card_idx] = "AS";
+    auto to = locate_sequence_card(m.to);
+    card to_card = piles[to.first][to.second];
 
-    pile::ref from_seq_ref = m.from / rules.max_rank;
-    pile::size_type from_card_idx = m.from % rules.max_rank;
-    assert(piles[from_seq_ref][from_card_idx] == "AS");
-    piles[from_seq_ref][from_card_idx] = to_card;
+    auto from = locate_sequence_card(m.from);
+    assert(piles[from.first][from.second] == "AS");
+    set_card(from.first, from.second, to_card);
+
+    set_card(to.first, to.second, "AS");
 }
 
 void game_state::make_accordion_move(move m) {
@@ -610,7 +622,12 @@ void game_state::undo_accordion_move(move m) {
 // Places a card on a pile and if it is on a tableau, cell or reserve pile,
 // reorders the pile refs so that the largest pile is first
 void game_state::place_card(pile::ref pr, card c) {
-    piles[pr].place(c);
+    index_top_card(pr, false);
+    piles[pr].place(c, extends_built_group(pr, c));
+    index_top_card(pr, true);
+    foundation_cards += is_foundation(pr);
+    add_card_location(pr, pile::size_type(piles[pr].size() - 1), c);
+    eval_hash(pr, pile::size_type(piles[pr].size() - 1), c, true);
 
 #ifndef NO_PILE_SYMMETRY
     // If the stock deals to the tableau piles, there is no pile symmetry
@@ -622,7 +639,12 @@ void game_state::place_card(pile::ref pr, card c) {
 
 // Same as above but for taking cards
 card game_state::take_card(pile::ref pr) {
+    index_top_card(pr, false);
     card c = piles[pr].take();
+    index_top_card(pr, true);
+    foundation_cards -= is_foundation(pr);
+    remove_card_location(pr, piles[pr].size(), c);
+    eval_hash(pr, piles[pr].size(), c, false);
 #ifndef NO_PILE_SYMMETRY
     // If the stock deals to the tableau piles, there is no pile symmetry
     if (rules.stock_size == 0 || rules.stock_deal_t != sdt::TABLEAU_PILES) {
@@ -632,6 +654,141 @@ card game_state::take_card(pile::ref pr) {
     return c;
 }
 
+// Turns the top card of a pile face up or down. Card comparisons ignore
+// whether a card is face down, so the pile order is unaffected
+void game_state::turn_face_up(pile::ref pr) {
+    card c = piles[pr][0];
+    c.turn_face_up();
+    set_card(pr, 0, c);
+}
+
+void game_state::turn_face_down(pile::ref pr) {
+    card c = piles[pr][0];
+    c.turn_face_down();
+    set_card(pr, 0, c);
+}
+
+///////////////////////
+// DERIVED PILE DATA //
+///////////////////////
+
+// The foundations base decides which cards can be built on each other, so
+// re-evaluates the built groups of the cards already dealt
+void game_state::set_foundations_base(card::rank_t base) {
+    foundations_base = base;
+    init_card_relations();
+    for (pile::ref pr = 0; pr < piles.size(); pr++)
+        if (!piles[pr].empty())
+            eval_built_groups(pr, pile::size_type(piles[pr].size() - 1));
+}
+
+// Whether a card placed on a pile would extend the built group at its top
+bool game_state::extends_built_group(pile::ref pr, card c) const {
+    return !piles[pr].empty()
+           && !piles[pr].top_card().is_face_down()
+           && is_next_built_group_card(piles[pr].top_card(), c);
+}
+
+// Re-evaluates the runs of the cards from the given index to the top of the
+// pile, after the card at that index has changed
+void game_state::eval_built_groups(pile::ref pr, pile::size_type idx) {
+    for (auto i = pile::size_type(idx + 1); i-- > 0;) {
+        bool extends = i + 1 < piles[pr].size()
+                       && !piles[pr][i + 1].is_face_down()
+                       && is_next_built_group_card(piles[pr][i + 1], piles[pr][i]);
+        piles[pr].set(i, piles[pr][i], extends);
+    }
+}
+
+bool game_state::is_foundation(pile::ref pr) const {
+    return rules.foundations_present
+           && pr >= foundations.front()
+           && pr < foundations.front() + foundations.size();
+}
+
+////////////////////////////
+// TABLEAU TOP-CARD INDEX //
+////////////////////////////
+
+// Whether to keep the index. It only finds the piles single cards can be
+// moved to, so isn't kept if the tableau can't be built on
+bool game_state::uses_top_card_index(const sol_rules& r) {
+    return r.tableau_pile_count > 0 && r.build_pol != sol_rules::build_policy::NO_BUILD;
+}
+
+bool game_state::is_tableau(pile::ref pr) const {
+    return !original_tableau_piles.empty()
+           && pr >= original_tableau_piles.front()
+           && pr <= original_tableau_piles.back();
+}
+
+// Adds the top card of a tableau pile to the index, or if the pile is empty
+// marks it as such. Otherwise removes it, before the pile is changed
+void game_state::index_top_card(pile::ref pr, bool add) {
+    if (!top_card_index || !is_tableau(pr)) return;
+    uint64_t pile_bit = uint64_t(1) << (pr - original_tableau_piles.front());
+
+    if (piles[pr].empty()) {
+        empty_tableau_piles = add ? empty_tableau_piles | pile_bit : empty_tableau_piles & ~pile_bit;
+        return;
+    }
+
+    uint8_t idx = relation_index(piles[pr].top_card());
+    if (add) {
+        tableau_top_piles[idx] |= pile_bit;
+        tableau_tops |= uint64_t(1) << idx;
+    } else {
+        tableau_top_piles[idx] &= ~pile_bit;
+        if (tableau_top_piles[idx] == 0) tableau_tops &= ~(uint64_t(1) << idx);
+    }
+}
+
+////////////////////
+// CARD LOCATIONS //
+////////////////////
+
+// The number of location slots kept for each card, or zero if the game never
+// looks cards up, in which case the locations aren't kept
+uint8_t game_state::card_location_copies(const sol_rules& r) {
+    // Gaps deals all four aces as the same 'gap' placeholder, and its moves
+    // briefly hold two copies of the card moved
+    if (r.sequence_count > 0) return uint8_t(r.two_decks ? 8 : 4);
+    // Otherwise, only the auto-foundation dominance needs them
+    if (r.foundations_present && !r.two_decks && !r.foundations_only_comp_piles) return 1;
+    return 0;
+}
+
+// The slots for each copy of a card. Slots not in use have a pile ref of 255
+std::pair<game_state::location_iterator, game_state::location_iterator> game_state::find_card(card c) const {
+    auto first = begin(card_locations) + ((c.get_rank() - 1) * 4 + c.get_suit()) * card_copies;
+    return {first, first + card_copies};
+}
+
+// Whether the card at the location is the top card of its pile
+bool game_state::is_exposed(card_location l) const {
+    return l.pr != 255 && l.pos + 1 == piles[l.pr].size();
+}
+
+void game_state::add_card_location(pile::ref pr, pile::size_type pos, card c) {
+    if (card_copies == 0) return;
+    auto slots = find_card(c);
+    auto slot = std::find_if(slots.first, slots.second, [](const card_location& l) { return l.pr == 255; });
+    // Only a deal that repeats a card more often than the decks do can run out
+    if (slot == slots.second) throw runtime_error("the deal holds more copies of " + c.to_string() + " than its decks");
+
+    card_locations[slot - begin(card_locations)] = card_location{pr, pos};
+}
+
+void game_state::remove_card_location(pile::ref pr, pile::size_type pos, card c) {
+    if (card_copies == 0) return;
+    auto slots = find_card(c);
+    auto slot = std::find_if(slots.first, slots.second,
+                             [&](const card_location& l) { return l.pr == pr && l.pos == pos; });
+    assert(slot != slots.second);
+
+    card_locations[slot - begin(card_locations)] = card_location{255, 0};
+}
+
 #ifndef NDEBUG
 void game_state::check_face_down_consistent() const {
     for (auto& p : original_tableau_piles) {
@@ -641,10 +798,22 @@ void game_state::check_face_down_consistent() const {
 
         // Makes sure face down cards are never above face down ones
         bool seen_face_up = false;
-        for (auto& c : piles[p].pile_vec) {
+        pile::size_type face_down = 0;
+        for (pile::size_type i = piles[p].size(); i-- > 0;) {
+            card c = piles[p][i];
             seen_face_up = seen_face_up || !c.is_face_down();
             assert(!(c.is_face_down() && seen_face_up));
+            face_down += c.is_face_down();
         }
+        assert(face_down == piles[p].face_down_count());
+
+        // Makes sure the running built group height matches a rescan
+        pile::size_type i = 1;
+        while (i < piles[p].size()
+               && is_next_built_group_card(piles[p][i], piles[p][i-1])
+               && !piles[p][i].is_face_down())
+            i++;
+        assert(i == piles[p].built_group_height());
     }
 }
 #endif
@@ -660,15 +829,11 @@ bool game_state::is_solved() const {
         solved = piles[hole].size()
                  == rules.max_rank * 4 * (rules.two_decks ? 2 : 1);
     } else if (rules.foundations_present) {
-        for (auto f : foundations) {
-            if (piles[f].size() != rules.max_rank) {
-                solved = false;
-            }
-        }
+        solved = foundation_cards == rules.max_rank * foundations.size();
     } else if (rules.sequence_count > 0) {
         for (pile::ref i = 0; i < sequences.size() && solved; i++) {
             for (pile::ref j = piles[sequences[i]].size(); j-- > 2;) {
-                if (!is_next_legal_card(rules.sequence_build_pol, piles[sequences[i]][j-1], piles[sequences[i]][j])) {
+                if (!is_related(relations->sequence, piles[sequences[i]][j-1], piles[sequences[i]][j])) {
                     solved = false;
                     break;
                 }
@@ -720,6 +885,46 @@ const std::vector<pile>& game_state::get_data() const {
     return piles;
 }
 
+game_state::engine game_state::get_engine() const {
+    return move_engine;
+}
+
+std::pair<game_state::pile_kind, uint8_t> game_state::locate_pile(pile::ref pr) const {
+    assert(pr < piles.size());
+    if (pr == hole) return {pile_kind::HOLE, 0};
+    if (pr == stock) return {pile_kind::STOCK, 0};
+    if (pr == waste) return {pile_kind::WASTE, 0};
+
+    // The piles of each kind were created one after the other
+    const std::pair<pile_kind, const vector<pile::ref>*> kinds[] = {
+            {pile_kind::FOUNDATION, &foundations},
+            {pile_kind::CELL, &original_cells},
+            {pile_kind::RESERVE, &original_reserve},
+            {pile_kind::TABLEAU, &original_tableau_piles},
+            {pile_kind::SEQUENCE, &sequences}
+    };
+    for (const auto& k : kinds) {
+        const vector<pile::ref>& refs = *k.second;
+        if (!refs.empty() && pr >= refs.front() && pr <= refs.back()) {
+            return {k.first, uint8_t(pr - refs.front())};
+        }
+    }
+
+    // Otherwise it is an accordion pile. Those are dropped as they are
+    // emptied, so the first is found from the piles laid out before it
+    const size_t first_accordion = (hole != 255) + foundations.size() + original_cells.size()
+                                   + (stock != 255) + (waste != 255) + original_reserve.size();
+    return {pile_kind::ACCORDION, uint8_t(pr - first_accordion)};
+}
+
+// Sequence moves number the cards of the sequences one after another, each
+// sequence's from its top card down. Every sequence holds the same number
+std::pair<pile::ref, pile::size_type> game_state::locate_sequence_card(uint8_t idx) const {
+    const pile::size_type seq_size = piles[sequences.front()].size();
+    assert(idx / seq_size < sequences.size());
+    return {sequences[idx / seq_size], pile::size_type(idx % seq_size)};
+}
+
 
 ///////////
 // PRINT //
@@ -729,3 +934,15 @@ ostream& operator<< (ostream& str, const game_state& gs) {
     return state_printer::print(str, gs);
 }
 
+ostream& operator<< (ostream& str, game_state::engine e) {
+    switch (e) {
+        case game_state::engine::GENERIC:    return str << "generic";
+        case game_state::engine::KLONDIKE:   return str << "klondike";
+        case game_state::engine::FREE_CELL:  return str << "free-cell";
+        case game_state::engine::CANFIELD:   return str << "canfield";
+        case game_state::engine::SPIDER:     return str << "spider";
+        case game_state::engine::BLACK_HOLE: return str << "black-hole";
+    }
+    return str;
+}
+
@@ -104,53 +104,57 @@ optional<move> game_state::get_dominance_move() const {
     if (!rules.foundations_present || rules.two_decks || rules.foundations_only_comp_piles)
         return boost::none;
 
-    // Cycles through the piles and sees if any cards can be automatically moved
-    // to the foundations
-    for (pile::ref pr = 0; pr < piles.size(); pr++) {
-        // Don't move foundation cards, hole, waste or stock cards to the foundations
-        if ((pr >= foundations.front() && pr <= foundations.back())
-            || (rules.hole && pr == hole)
-            || (rules.stock_size > 0 && pr == stock && (rules.stock_deal_count != 1 || !rules.stock_redeal))
-            || (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE && pr == waste) // && (rules.stock_deal_count != 1 || !rules.stock_redeal))
-            || (piles[pr].empty())) {
-            continue;
+    // Looks up the next card for each foundation, and sees if any of them can be
+    // automatically moved there. Picks the one on the lowest pile ref, as a scan
+    // through the piles would
+    optional<move> dominance_move;
+    pile::ref dominance_pr = 255;
+    for (pile::ref target_foundation : foundations) {
+        card::rank_t target_rank = piles[target_foundation].empty()
+                                   ? card::rank_t(1)
+                                   : foundation_base_convert(piles[target_foundation].top_card().get_rank() + card::rank_t(1));
+        card c(card::suit_t(target_foundation - foundations.front()),
+               card::rank_t((target_rank + foundations_base - 2) % rules.max_rank + 1));
+
+        auto slots = find_card(c);
+        for (auto l = slots.first; l != slots.second; l++) {
+            // Don't move foundation cards, hole, waste or stock cards to the foundations
+            if (!is_exposed(*l) || l->pr >= dominance_pr
+                || is_foundation(l->pr)
+                || (rules.hole && l->pr == hole)
+                || (rules.stock_size > 0 && (l->pr == stock || (rules.stock_deal_t == sdt::WASTE && l->pr == waste)))
+                || !is_valid_auto_foundation_move(target_foundation)) {
+                continue;
+            }
+
+            // make move which is definitely dominance and might be a reveal move
+            pile::ref pr = l->pr;
+            dominance_move = move(move::mtype::regular, pr, target_foundation, 1, (piles[pr].size() > 1 && piles[pr][1].is_face_down()), false, true);
+            dominance_pr = pr;
         }
+    }
 
-       if (pr==stock) { 
-		assert(rules.stock_deal_count == 1 && rules.stock_redeal);
-		// multiple cards to deal with
-	        for (auto k_plus_mv : generate_k_plus_moves_to_check()) {
-		    	card c = stock_card_from_count(k_plus_mv.first);
-			pile::ref target_foundation = foundations[c.get_suit()];
-			// If the card is the right rank and the auto-move boolean is true, then
-			// returns the move
-			card::rank_t target_rank = piles[target_foundation].empty()
-						   ? card::rank_t(1)
-						   : foundation_base_convert(piles[target_foundation].top_card().get_rank() + card::rank_t(1));
-			if (target_rank == foundation_base_convert(c.get_rank()) &&
-                            is_valid_auto_foundation_move(target_foundation)) {
-		   	// create dominance stock_k_plus move
-			    move m(move::mtype::stock_k_plus, stock, target_foundation, k_plus_mv.first, false, k_plus_mv.second, true);
-			    return m;
-			}
-		}
-        } else { 
-		// only one card to deal with
-		card c = piles[pr].top_card();
-		pile::ref target_foundation = foundations[c.get_suit()];
-		// If the card is the right rank and the auto-move boolean is true, then
-		// returns the move
-		card::rank_t target_rank = piles[target_foundation].empty()
-					   ? card::rank_t(1)
-					   : foundation_base_convert(piles[target_foundation].top_card().get_rank() + card::rank_t(1));
-		if (target_rank == foundation_base_convert(c.get_rank()) &&
-                    is_valid_auto_foundation_move(target_foundation)) {
-		    // make move which is definitely dominance and might be a reveal move
-		    move m(move::mtype::regular, pr, target_foundation, 1, (piles[pr].size() > 1 && piles[pr][1].is_face_down()), false, true);
-		    return m;
-	        }
+    // The stock is only considered when one card is dealt at a time and it can be
+    // redealt. It has multiple cards to deal with
+    if (rules.stock_size > 0 && stock < dominance_pr && !piles[stock].empty()
+        && rules.stock_deal_count == 1 && rules.stock_redeal) {
+        for (auto k_plus_mv : generate_k_plus_moves_to_check()) {
+            card c = stock_card_from_count(k_plus_mv.first);
+            pile::ref target_foundation = foundations[c.get_suit()];
+            // If the card is the right rank and the auto-move boolean is true, then
+            // returns the move
+            card::rank_t target_rank = piles[target_foundation].empty()
+                                       ? card::rank_t(1)
+                                       : foundation_base_convert(piles[target_foundation].top_card().get_rank() + card::rank_t(1));
+            if (target_rank == foundation_base_convert(c.get_rank()) &&
+                is_valid_auto_foundation_move(target_foundation)) {
+                // create dominance stock_k_plus move
+                return move(move::mtype::stock_k_plus, stock, target_foundation, k_plus_mv.first, false, k_plus_mv.second, true);
             }
+        }
     }
+
+    if (dominance_move) return dominance_move;
 #endif
 
     return boost::none;
@@ -185,16 +189,6 @@ optional<move> game_state::auto_waste_stock_move() const {
     return boost::none;
 }
 
-bool game_state::is_ordered_pile(pile::ref pr) const {
-    if (piles[pr].size() != rules.max_rank) return false;
-
-    card::suit_t s = piles[pr][0].get_suit();
-    for (card::rank_t r = 0; r < rules.max_rank; r++) {
-        if (piles[pr][r] != card(s, card::rank_t(r + 1))) return false;
-    }
-    return true;
-}
-
 // For games where the foundations can be removed from, this dominance blocks
 // the foundations being removed from if the card that were to be removed would
 // go 'automatically' up
@@ -205,7 +199,7 @@ bool game_state::dominance_blocks_foundation_move(pile::ref target_pile) {
     piles[target_pile].take();
 
     bool blocked = is_valid_auto_foundation_move(target_pile);
-    piles[target_pile].place(target_card);
+    piles[target_pile].place(target_card, extends_built_group(target_pile, target_card));
 
     return blocked;
 }
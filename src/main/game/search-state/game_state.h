@@ -29,6 +29,8 @@
 #include <string>
 #include <random>
 #include <functional>
+#include <array>
+#include <memory>
 
 #include <boost/functional/hash.hpp>
 #include <boost/optional/optional.hpp>
@@ -36,6 +38,7 @@
 #include "document.h"
 #include "../card.h"
 #include "../pile.h"
+#include "../ordered_piles.h"
 #include "../sol_rules.h"
 #include "../move.h"
 
@@ -43,12 +46,20 @@ class game_state {
     friend class hasher;
     friend class global_cache;
     friend class cached_game_state;
+    friend class state_key_format;
     friend class deal_parser;
     friend class state_printer;
     friend class test_helper;
     friend class json_helper;
 public:
     enum class streamliner_options {NONE, AUTO_FOUNDATIONS, SUIT_SYMMETRY, BOTH};
+    // The groups legal moves are generated in, in the order they are tried
+    enum class move_stage : uint8_t {FOUNDATION, TABLEAU, STOCK_AND_CELLS, NONE};
+    // The move generators. Each but the generic one is compiled for the rules
+    // of a preset, and is used by any state whose rules match them
+    enum class engine : uint8_t {GENERIC, KLONDIKE, FREE_CELL, CANFIELD, SPIDER, BLACK_HOLE};
+    // The kinds of pile, in the order their piles are laid out
+    enum class pile_kind : uint8_t {HOLE, FOUNDATION, CELL, STOCK, WASTE, RESERVE, ACCORDION, TABLEAU, SEQUENCE};
 
     /* Constructors */
 
@@ -65,20 +76,34 @@ public:
     void undo_move(move);
     void place_card(pile::ref, card);
     card take_card(pile::ref);
+    void turn_face_up(pile::ref);
+    void turn_face_down(pile::ref);
 
     /* Legal move generation */
 
     std::vector<move> get_legal_moves(move = move(move::mtype::regular));
+    void get_legal_moves(std::vector<move>&, move);
+    void get_legal_moves(std::vector<move>&, move, move_stage);
+    static move_stage next_move_stage(move_stage);
+    static move_stage previous_move_stage(move_stage);
     boost::optional<move> get_dominance_move() const;
 
     /* State inspection */
 
     bool is_solved() const;
+    engine get_engine() const;
     const std::vector<pile>& get_data() const;
+    // The kind of a pile, and its position among the piles of that kind as dealt
+    std::pair<pile_kind, uint8_t> locate_pile(pile::ref) const;
+    // The sequence pile, and the index of the card in it, that a position in
+    // a sequence move refers to
+    std::pair<pile::ref, pile::size_type> locate_sequence_card(uint8_t) const;
+    uint64_t get_hash() const;
 
     /* Printing */
 
     friend std::ostream& operator<< (std::ostream&, const game_state&);
+    friend std::ostream& operator<< (std::ostream&, engine);
 
 private:
     /* Constructors (& helper function) */
@@ -90,12 +115,22 @@ private:
     /* Pile order logic */
 
     void eval_pile_order(pile::ref, bool);
-    void eval_pile_order(std::list<pile::ref>&, pile::ref, bool);
+    void eval_pile_order(ordered_piles&, pile::ref, bool);
+
+    /* Hashing logic */
+
+    void init_hash();
+    void eval_hash(pile::ref, pile::size_type, card, bool);
+    void set_card(pile::ref, pile::size_type, card);
+    uint8_t hash_code(card) const;
+    uint64_t stock_waste_hash() const;
+    uint64_t compute_hash() const;
 
     /* Altering state */
 
     void make_regular_move(move move);
     void undo_regular_move(move move);
+    void move_cards(pile::ref, pile::ref, pile::size_type);
     void make_built_group_move(move move);
     void undo_built_group_move(move move);
     void make_stock_k_plus_move(move move);
@@ -107,12 +142,69 @@ private:
     void make_accordion_move(move move);
     void undo_accordion_move(move move);
 
+    /* Derived pile data */
+
+    void set_foundations_base(card::rank_t);
+    bool extends_built_group(pile::ref, card) const;
+    void eval_built_groups(pile::ref, pile::size_type);
+    bool is_foundation(pile::ref) const;
+
+    /* Card relations */
+
+    // Bit b of row a is set when card b can go on card a. Cards are indexed
+    // by suit and rank, ignoring whether they are face down
+    typedef std::array<uint64_t, 64> card_relation;
+    struct card_relations {
+        card_relation tableau;
+        card_relation tableau_onto; // The tableau relation reversed: bit a of row b is set when b can go on a
+        card_relation built_group;
+        card_relation sequence;
+        card_relation accordion;
+        card_relation foundation;
+        card_relation hole;
+    };
+
+    void init_card_relations();
+    static uint8_t relation_index(card);
+    static bool is_related(const card_relation&, card, card);
+
+    /* Tableau top-card index */
+
+    static bool uses_top_card_index(const sol_rules&);
+    bool is_tableau(pile::ref) const;
+    void index_top_card(pile::ref, bool);
+    uint64_t tableau_targets(card) const;
+    void add_indexed_tableau_moves(std::vector<move>&, move, uint64_t) const;
+
+    /* Card locations */
+
+    // Where a card is, its position counted from the bottom of its pile so
+    // that it stays the same as cards are placed on top
+    struct card_location {
+        pile::ref pr;
+        pile::size_type pos;
+    };
+    typedef std::vector<card_location>::const_iterator location_iterator;
+
+    static uint8_t card_location_copies(const sol_rules&);
+    std::pair<location_iterator, location_iterator> find_card(card) const;
+    bool is_exposed(card_location) const;
+    void add_card_location(pile::ref, pile::size_type, card);
+    void remove_card_location(pile::ref, pile::size_type, card);
+
 #ifndef NDEBUG
     void check_face_down_consistent() const;
 #endif
 
     /* Legal move generation */
 
+    static engine pick_engine(const sol_rules&);
+    template<class R> void get_stage_moves(std::vector<move>&, move, move_stage);
+    template<class R> void add_stock_and_cell_stage_moves(std::vector<move>&, move);
+    template<class R> void add_tableau_stage_moves(std::vector<move>&, move);
+    template<class R> void add_foundation_stage_moves(std::vector<move>&, move);
+    pile::ref get_empty_cell() const;
+
     bool stock_can_deal_all_tableau() const;
     move get_stock_to_all_tableau_move() const;
 
@@ -138,7 +230,6 @@ private:
     void add_built_group_moves(std::vector<move>&, pile::ref, pile::size_type, bool, bool) const;
     void add_whole_pile_moves(std::vector<move>&) const;
     void add_whole_pile_moves(std::vector<move>&, pile::ref, pile::size_type) const;
-    pile::size_type get_built_group_height(pile::ref) const;
     bool is_next_built_group_card(card, card) const;
     void add_empty_built_group_moves(std::vector<move>&, pile::ref, pile::ref, pile::size_type, bool, bool, bool) const;
     void add_kings_only_built_group_move(std::vector<move>&, pile::ref, pile::ref, pile::size_type, bool) const;
@@ -148,15 +239,14 @@ private:
     bool tableau_space_and_auto_reserve() const;
 
     bool is_next_legal_card(sol_rules::build_policy, card, card) const;
-    bool is_next_legal_card(std::vector<sol_rules::accordion_policy>, card, card) const;
-    void turn_face_down_cards(std::vector<move>&) const;
+    bool is_next_legal_card(const std::vector<sol_rules::accordion_policy>&, card, card) const;
+    void turn_face_down_cards(std::vector<move>&, std::vector<move>::size_type) const;
 
     /* Auto-foundation moves */
 
     boost::optional<move> auto_reserve_move() const;
     boost::optional<move> auto_waste_stock_move() const;
     bool is_valid_auto_foundation_move(pile::ref) const;
-    bool is_ordered_pile(pile::ref) const;
     bool dominance_blocks_foundation_move(pile::ref);
     card::rank_t foundation_base_convert(card::rank_t) const;
 
@@ -164,15 +254,16 @@ private:
 
     const sol_rules rules;
     streamliner_options stream_opts;
+    engine move_engine;
     card::rank_t foundations_base;
 
     /* Pile references */
 
-    std::list<pile::ref> tableau_piles;
-    std::list<pile::ref> cells;
+    ordered_piles tableau_piles;
+    ordered_piles cells;
     pile::ref stock;
     pile::ref waste;
-    std::list<pile::ref> reserve;
+    ordered_piles reserve;
     std::vector<pile::ref> foundations;
     std::vector<pile::ref> sequences;
     std::list<pile::ref> accordion;
@@ -187,6 +278,35 @@ private:
     /* Core piles */
 
     std::vector<pile> piles;
+    pile::size_type foundation_cards; // Across all of the foundations
+
+    /* Which cards can go on which, computed from the rules. Shared between
+       copies of the state, as they never change during a search */
+
+    std::shared_ptr<const card_relations> relations;
+
+    /* The top cards of the tableau piles, so that every pile a card can be
+       moved to is found with a few mask operations. Bit i of a pile mask is
+       the i-th original tableau pile */
+
+    bool top_card_index;
+    uint64_t tableau_tops;                      // Relation indices of the top cards
+    std::array<uint64_t, 64> tableau_top_piles; // The piles each top card is on
+    uint64_t empty_tableau_piles;
+
+    /* Card locations, one slot per copy of each card. Unused slots have a
+       pile ref of 255 */
+
+    uint8_t card_copies;
+    std::vector<card_location> card_locations;
+
+    /* Running hash of the canonical state */
+
+    std::vector<uint64_t> pile_hashes;
+    std::vector<uint64_t> pile_salts;
+    uint64_t piles_hash;
+    uint64_t stock_poly;
+    uint64_t waste_poly;
 };
 
 #endif //SOLVITAIRE_GAME_STATE_H
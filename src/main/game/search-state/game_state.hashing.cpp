@@ -0,0 +1,226 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <cassert>
+
+#include "game_state.h"
+
+typedef sol_rules::build_policy pol;
+typedef sol_rules::stock_deal_type sdt;
+typedef game_state::streamliner_options sos;
+
+// The hash of a state is kept up to date as cards are placed, taken and
+// turned, so that the cache never has to walk over the whole state. It is
+// a hash of the same canonical form that cached_game_state stores:
+//
+//  - Each tableau, cell, reserve and sequence pile has a Zobrist hash (the XOR
+//    of a key for every (position, card) pair in it). Where the piles of a
+//    type are interchangeable, their mixed hashes are summed, so the hash does
+//    not depend on the pile order. Otherwise each pile is salted with its index
+//  - The stock and the reversed waste are hashed as one polynomial sequence,
+//    which dealing from the stock to the waste leaves unchanged
+//  - The hole and accordion only contribute their top cards, so are read when
+//    the hash is requested
+//  - Foundations are not part of the canonical form, so are ignored
+
+// Card key positions that are not pile indices
+static const uint8_t hole_pos = 253;
+static const uint8_t stock_split_pos = 254;
+static const uint8_t stock_waste_pos = 255;
+
+static const uint64_t stock_salt = 0x5851f42d4c957f2dULL;
+static const uint64_t accordion_salt = 0x14057b7ef767814fULL;
+
+// The polynomial base for the stock and waste, and its inverse mod 2^64
+static const uint64_t poly_base = 0x9e3779b97f4a7c15ULL;
+static const uint64_t poly_base_inv = 0xf1de83e19937733dULL;
+static_assert(poly_base * poly_base_inv == 1, "Invalid polynomial base inverse");
+
+// The finaliser of the splitmix64 generator
+static uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t card_key(uint8_t pos, uint8_t code) {
+    return mix64((uint64_t(pos) << 8 | code) + 0x2545f4914f6cdd1dULL);
+}
+
+struct poly_powers {
+    poly_powers() {
+        fwd[0] = inv[0] = 1;
+        for (int i = 1; i <= 256; i++) {
+            fwd[i] = fwd[i-1] * poly_base;
+            inv[i] = inv[i-1] * poly_base_inv;
+        }
+    }
+    uint64_t fwd[257];
+    uint64_t inv[257];
+};
+
+static const poly_powers& powers() {
+    static const poly_powers p;
+    return p;
+}
+
+// Resets the hash to that of a state with all piles empty, and decides which
+// piles are hashed as interchangeable
+void game_state::init_hash() {
+    pile_hashes.assign(piles.size(), 0);
+    pile_salts.assign(piles.size(), 0);
+
+    bool pile_symmetry = rules.stock_size == 0 || rules.stock_deal_t != sdt::TABLEAU_PILES;
+#ifdef NO_PILE_SYMMETRY
+    pile_symmetry = false;
+#endif
+
+    auto salt_piles = [&](const std::vector<pile::ref>& prs, uint64_t type, bool symmetric) {
+        for (uint64_t i = 0; i < prs.size(); i++) {
+            pile_salts[prs[i]] = mix64(type << 8 | (symmetric ? 0 : i + 1));
+        }
+    };
+    salt_piles(original_tableau_piles, 1, pile_symmetry);
+    salt_piles(original_cells, 2, pile_symmetry);
+    salt_piles(original_reserve, 3, pile_symmetry);
+    salt_piles(sequences, 4, false);
+
+    piles_hash = 0;
+    for (uint64_t salt : pile_salts) {
+        if (salt != 0) piles_hash += mix64(salt);
+    }
+    stock_poly = 0;
+    waste_poly = 0;
+}
+
+// Updates the hash for a card being placed at, or taken from, the given
+// position (counted from the bottom) of a pile
+void game_state::eval_hash(pile::ref pr, pile::size_type pos, card c, bool is_place) {
+    uint8_t code = hash_code(c);
+
+    if (pile_salts[pr] != 0) {
+        uint64_t salt = pile_salts[pr];
+        uint64_t old_hash = pile_hashes[pr];
+        pile_hashes[pr] ^= card_key(pos, code);
+        piles_hash += mix64(pile_hashes[pr] + salt) - mix64(old_hash + salt);
+    } else if (pr == stock) {
+        uint64_t term = card_key(stock_waste_pos, code) * powers().fwd[pos];
+        stock_poly = is_place ? stock_poly + term : stock_poly - term;
+    } else if (pr == waste) {
+        uint64_t term = card_key(stock_waste_pos, code) * powers().inv[pos + 1];
+        waste_poly = is_place ? waste_poly + term : waste_poly - term;
+    }
+}
+
+// Replaces the card at the given index (counted from the top) of a pile
+void game_state::set_card(pile::ref pr, pile::size_type idx, card c) {
+    auto pos = pile::size_type(piles[pr].size() - 1 - idx);
+    eval_hash(pr, pos, piles[pr][idx], false);
+    if (piles[pr][idx] != c) { // Turning a card over doesn't move it
+        remove_card_location(pr, pos, piles[pr][idx]);
+        add_card_location(pr, pos, c);
+    }
+    if (idx == 0) index_top_card(pr, false);
+    piles[pr].set(idx, c);
+    if (idx == 0) index_top_card(pr, true);
+    eval_built_groups(pr, idx);
+    eval_hash(pr, pos, c, true);
+}
+
+// The value of the card in the canonical form. If the game is a 'hole-based'
+// game, or suit-reduction is on, reduces the suit of the card where possible
+uint8_t game_state::hash_code(card c) const {
+    bool is_suit_symmetry = (rules.foundations_present
+            && (stream_opts == sos::SUIT_SYMMETRY || stream_opts == sos::BOTH))
+            || rules.hole;
+
+    uint8_t suit_val = c.get_suit();
+    if (is_suit_symmetry) {
+        switch (rules.build_pol) {
+            case pol::SAME_SUIT:
+                break;
+            case pol::RED_BLACK:
+                suit_val = c.get_colour();
+                break;
+            default:
+                suit_val = 0;
+                break;
+        }
+    }
+
+    // Each suit takes a block of 2 * (13 + 1) codes, one for each rank and
+    // face, with the codes for rank 0 left unused
+    return static_cast<uint8_t>(suit_val * 2 * (13 + 1) + 2*c.get_rank() + c.is_face_down());
+}
+
+// The stock followed by the reversed waste, as a polynomial in the sequence
+// position. A card moving from the top of the stock to the top of the waste
+// keeps its position, so the hash only distinguishes the split point if the
+// canonical form does
+uint64_t game_state::stock_waste_hash() const {
+    pile::size_type waste_size = rules.stock_deal_t == sdt::WASTE ? piles[waste].size() : pile::size_type(0);
+    uint64_t h = stock_poly + powers().fwd[piles[stock].size() + waste_size] * waste_poly;
+
+    if (rules.stock_deal_t == sdt::WASTE) {
+        bool waste_deal_symmetry = rules.stock_redeal
+                && waste_size % rules.stock_deal_count == 0;
+
+        if (!waste_deal_symmetry) {
+            h += card_key(stock_split_pos, piles[stock].size());
+        }
+    }
+    return h;
+}
+
+uint64_t game_state::get_hash() const {
+    uint64_t h = piles_hash;
+
+    if (rules.stock_size > 0) {
+        h += mix64(stock_waste_hash() ^ stock_salt);
+    }
+
+    if (rules.hole) {
+        h += mix64(card_key(hole_pos, hash_code(piles[hole].top_card())));
+    }
+
+    if (!accordion.empty()) {
+        uint64_t acc_hash = 0;
+        uint8_t pos = 0;
+        for (pile::ref pr : accordion) {
+            acc_hash ^= card_key(pos++, hash_code(piles[pr].top_card()));
+        }
+        h += mix64(acc_hash ^ accordion_salt);
+    }
+
+    return mix64(h);
+}
+
+// Recomputes the hash from scratch. Used to check the running hash
+uint64_t game_state::compute_hash() const {
+    game_state gs(*this);
+    gs.init_hash();
+
+    for (pile::ref pr = 0; pr < piles.size(); pr++) {
+        for (pile::size_type pos = 0; pos < piles[pr].size(); pos++) {
+            gs.eval_hash(pr, pos, piles[pr][piles[pr].size() - 1 - pos], true);
+        }
+    }
+    return gs.get_hash();
+}
@@ -24,13 +24,14 @@
 #include "game_state.h"
 #include "../sol_rules.h"
 #include "../move.h"
+#include "rules_traits.h"
 
 #include <boost/optional/optional.hpp>
 #include <iostream>
+#include <algorithm>
 
 using std::vector;
 using std::min;
-using std::list;
 using std::pair;
 using std::set;
 using std::greater;
@@ -40,7 +41,6 @@ typedef sol_rules::build_policy pol;
 typedef sol_rules::spaces_policy s_pol;
 typedef sol_rules::accordion_policy acc_pol;
 typedef sol_rules::stock_deal_type sdt;
-typedef sol_rules::face_up_policy fu;
 typedef sol_rules::direction dir;
 typedef sol_rules::built_group_type bgt;
 
@@ -50,11 +50,20 @@ typedef sol_rules::built_group_type bgt;
 
 // Note that the moves added last here, are tried first
 vector<move> game_state::get_legal_moves(move parent_move) {
+    vector<move> moves;
+    get_legal_moves(moves, parent_move);
+    return moves;
+}
+
+// Appends the legal moves to the given vector, so that the solver can keep
+// the moves of every level of its search in one stack
+void game_state::get_legal_moves(vector<move>& moves, move parent_move) {
     // Order:
     // Stock waste deal type move
     // Accordion moves
     // Foundations complete piles moves
     // Tableau / cells / reserve / stock-waste (redeal) to hole / foundation moves
+    // -- end of foundation stage --
     // Cell to tableau moves
     // Sequence to sequence moves
     // Tableau to tableau moves
@@ -62,28 +71,99 @@ vector<move> game_state::get_legal_moves(move parent_move) {
     // Stock-waste to tableau moves (redeal)
     // Reserve to tableau moves
     // Foundation to tableau moves
+    // -- end of tableau stage --
     // Stock-waste to tableau moves (no redeal)
     // Stock-waste (no redeal) to hole / foundation moves
     // Tableau / reserve / stock-waste to cell moves
     // Stock to all tableau moves
     // Stock-hole deal type move
 
+    for (move_stage s = move_stage::STOCK_AND_CELLS; s != move_stage::NONE; s = previous_move_stage(s))
+        get_legal_moves(moves, parent_move, s);
+}
+
+// Appends one stage of the legal moves. The stages are ordered by when their
+// moves are tried, so generating them one at a time from FOUNDATION onwards,
+// each only once the moves of the last are exhausted, searches in the same
+// order as generating them all up front
+void game_state::get_legal_moves(vector<move>& moves, move parent_move, move_stage stage) {
+    switch (move_engine) {
+        case engine::GENERIC:    get_stage_moves<generic_traits>(moves, parent_move, stage);    break;
+        case engine::KLONDIKE:   get_stage_moves<klondike_traits>(moves, parent_move, stage);   break;
+        case engine::FREE_CELL:  get_stage_moves<free_cell_traits>(moves, parent_move, stage);  break;
+        case engine::CANFIELD:   get_stage_moves<canfield_traits>(moves, parent_move, stage);   break;
+        case engine::SPIDER:     get_stage_moves<spider_traits>(moves, parent_move, stage);     break;
+        case engine::BLACK_HOLE: get_stage_moves<black_hole_traits>(moves, parent_move, stage); break;
+    }
+}
+
+template<class R>
+void game_state::get_stage_moves(vector<move>& moves, move parent_move, move_stage stage) {
+    // Moves already in the vector belong to the caller, and are left alone
+    const vector<move>::size_type first_move = moves.size();
 
-    vector<move> moves;
+    switch (stage) {
+        case move_stage::FOUNDATION:
+            add_foundation_stage_moves<R>(moves, parent_move);
+            break;
+        case move_stage::TABLEAU:
+            add_tableau_stage_moves<R>(moves, parent_move);
+            break;
+        case move_stage::STOCK_AND_CELLS:
+            add_stock_and_cell_stage_moves<R>(moves, parent_move);
+            break;
+        case move_stage::NONE:
+            return;
+    }
 
+    if (R::face_down_cards(rules))
+        turn_face_down_cards(moves, first_move);
+
+    if (stage == move_stage::FOUNDATION && R::accordion(rules))
+        add_accordion_moves(moves);
+}
+
+// The first of the specialised engines whose traits match the rules. Building
+// with NO_SPECIALISED_ENGINES always uses the generic one, for comparison
+game_state::engine game_state::pick_engine(const sol_rules& r) {
+#ifndef NO_SPECIALISED_ENGINES
+    if (traits_match<klondike_traits>(r))   return engine::KLONDIKE;
+    if (traits_match<free_cell_traits>(r))  return engine::FREE_CELL;
+    if (traits_match<canfield_traits>(r))   return engine::CANFIELD;
+    if (traits_match<spider_traits>(r))     return engine::SPIDER;
+    if (traits_match<black_hole_traits>(r)) return engine::BLACK_HOLE;
+#endif
+    return engine::GENERIC;
+}
+
+game_state::move_stage game_state::next_move_stage(move_stage s) {
+    switch (s) {
+        case move_stage::FOUNDATION:      return move_stage::TABLEAU;
+        case move_stage::TABLEAU:         return move_stage::STOCK_AND_CELLS;
+        default:                          return move_stage::NONE;
+    }
+}
+
+game_state::move_stage game_state::previous_move_stage(move_stage s) {
+    switch (s) {
+        case move_stage::STOCK_AND_CELLS: return move_stage::TABLEAU;
+        case move_stage::TABLEAU:         return move_stage::FOUNDATION;
+        default:                          return move_stage::NONE;
+    }
+}
+
+template<class R>
+void game_state::add_stock_and_cell_stage_moves(vector<move>& moves, move parent_move) {
     // Stock-hole deal type move
-    if (rules.stock_deal_t == sdt::HOLE && !piles[stock].empty())
+    if (R::stock_deal_t(rules) == sdt::HOLE && !piles[stock].empty())
         add_stock_hole_move(moves);
 
     // Stock to all tableau moves
-    if (rules.stock_size > 0 && stock_can_deal_all_tableau())
+    if (R::stock(rules) && stock_can_deal_all_tableau())
             moves.emplace_back(get_stock_to_all_tableau_move());
 
     // Tableau / reserve / stock-waste to cell moves
-    pile::ref empty_cell = 255;
-    for (auto c : cells) {
-        if (piles[c].empty()) empty_cell = c;
-    }
+    pile::ref empty_cell = get_empty_cell();
     if (empty_cell != 255) {
         for (auto t : tableau_piles) {
             if (piles[t].empty() || parent_move.to == t) continue;
@@ -94,22 +174,26 @@ vector<move> game_state::get_legal_moves(move parent_move) {
             if (!piles[r].empty())
                 moves.emplace_back(move::mtype::regular, r, empty_cell);
 
-        if (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE)
+        if (R::stock(rules) && R::stock_deal_t(rules) == sdt::WASTE)
             add_stock_to_cell_move(moves, empty_cell);
     }
 
     // Stock-waste (no redeal) to hole / foundation moves
-    if (rules.hole || (rules.foundations_present && !rules.foundations_only_comp_piles)) {
-        if (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE && !rules.stock_redeal)
+    if (R::hole(rules) || (R::foundations_present(rules) && !R::foundations_only_comp_piles(rules))) {
+        if (R::stock(rules) && R::stock_deal_t(rules) == sdt::WASTE && !R::stock_redeal(rules))
             add_stock_to_hole_foundation_moves(moves);
     }
 
     // Stock-waste to tableau moves (no redeal)
-    if (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE && !rules.stock_redeal)
+    if (R::stock(rules) && R::stock_deal_t(rules) == sdt::WASTE && !R::stock_redeal(rules))
         add_stock_to_tableau_moves(moves);
+}
 
+template<class R>
+void game_state::add_tableau_stage_moves(vector<move>& moves, move parent_move) {
     // Foundation to tableau / empty cell moves
-    if (rules.foundations_removable) {
+    if (R::foundations_removable(rules)) {
+        pile::ref empty_cell = get_empty_cell();
         for (auto f : foundations) {
 	// have to allow immediate reversal of worry back if it might have turned up a card
             if (piles[f].empty() || ((parent_move.to == f) && !parent_move.reveal_move) || dominance_blocks_foundation_move(f)) continue;
@@ -129,11 +213,11 @@ vector<move> game_state::get_legal_moves(move parent_move) {
     }
 
     // Stock-waste to tableau moves (redeal)
-    if (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE && rules.stock_redeal)
+    if (R::stock(rules) && R::stock_deal_t(rules) == sdt::WASTE && R::stock_redeal(rules))
         add_stock_to_tableau_moves(moves);
 
     // Tableau built group moves
-    switch (rules.move_built_group) {
+    switch (R::move_built_group(rules)) {
         case sol_rules::built_group_type::YES:
             add_built_group_moves(moves, false, false);
             break;
@@ -153,7 +237,7 @@ vector<move> game_state::get_legal_moves(move parent_move) {
     // Tableau to tableau single card moves
     // If only whole pile moves are available, or we are dealing with single card moves as built groups, doesn't make regular ones
 
-    if ((rules.move_built_group != bgt::WHOLE_PILE) && (rules.move_built_group != bgt::MAXIMAL_GROUP) && (rules.move_built_group != bgt::PARTIAL_IF_CARD_ABOVE_BUILDABLE)) {
+    if ((R::move_built_group(rules) != bgt::WHOLE_PILE) && (R::move_built_group(rules) != bgt::MAXIMAL_GROUP) && (R::move_built_group(rules) != bgt::PARTIAL_IF_CARD_ABOVE_BUILDABLE)) {
 
         for (auto t_from : tableau_piles) {
             
@@ -174,6 +258,15 @@ vector<move> game_state::get_legal_moves(move parent_move) {
             // reverse would be immediately caught in the cache/transposition table. So although desirable 
             // for efficiency, this is commented out for safety reasons.
 
+            if (top_card_index) {
+                uint64_t targets = tableau_targets(piles[t_from].top_card())
+                                   & ~(uint64_t(1) << (t_from - original_tableau_piles.front()));
+                // Forbid moves from single-card piles to empty piles
+                if (piles[t_from].size() == 1) targets &= ~empty_tableau_piles;
+                add_indexed_tableau_moves(moves, move(move::mtype::regular, t_from), targets);
+                continue;
+            }
+
             for (auto to : tableau_piles) {
                 if (is_valid_tableau_move(t_from, to)
             // Forbid moves from single-card piles to empty piles
@@ -185,7 +278,7 @@ vector<move> game_state::get_legal_moves(move parent_move) {
     }
 
     // Sequence to sequence moves
-    if (rules.sequence_count > 0) {
+    if (R::sequences(rules)) {
         add_sequence_moves(moves);
     }
 
@@ -195,38 +288,42 @@ vector<move> game_state::get_legal_moves(move parent_move) {
 
         add_valid_tableau_moves(moves, c);
     }
+}
 
+template<class R>
+void game_state::add_foundation_stage_moves(vector<move>& moves, move parent_move) {
     // Tableau / cells / reserve / stock-waste (redeal) to hole / foundation moves
-    if (rules.hole || (rules.foundations_present && !rules.foundations_only_comp_piles)) {
+    if (R::hole(rules) || (R::foundations_present(rules) && !R::foundations_only_comp_piles(rules))) {
         // Stock
-        if (rules.stock_size > 0 && rules.stock_deal_t == sdt::WASTE && rules.stock_redeal)
+        if (R::stock(rules) && R::stock_deal_t(rules) == sdt::WASTE && R::stock_redeal(rules))
             add_stock_to_hole_foundation_moves(moves);
 
-        list<pile::ref> from_piles = tableau_piles;
-        if (rules.cells > 0) from_piles.insert(from_piles.end(), cells.begin(), cells.end());
-        if (rules.reserve_size > 0) from_piles.insert(from_piles.end(), reserve.begin(), reserve.end());
-
-        for (auto fp : from_piles) {
-            if (piles[fp].empty() || (parent_move.to == fp && !parent_move.dominance_move)) continue;
+        auto add_from_pile_moves = [&](pile::ref fp) {
+            if (piles[fp].empty() || (parent_move.to == fp && !parent_move.dominance_move)) return;
 
             for (auto f : foundations)
                 if (is_valid_foundations_move(fp, f))
                     moves.emplace_back(move::mtype::regular, fp, f);
-            if (rules.hole && is_valid_hole_move(fp))
+            if (R::hole(rules) && is_valid_hole_move(fp))
                 moves.emplace_back(move::mtype::regular, fp, hole);
-        }
+        };
+
+        for (auto t : tableau_piles) add_from_pile_moves(t);
+        if (R::cells(rules)) for (auto c : cells) add_from_pile_moves(c);
+        if (R::reserve(rules)) for (auto r : reserve) add_from_pile_moves(r);
     }
 
-    if (rules.foundations_only_comp_piles) // i.e. Spider-type winning condition
+    if (R::foundations_only_comp_piles(rules)) // i.e. Spider-type winning condition
         add_foundation_complete_piles_moves(moves);
+}
 
-    if (rules.tableau_pile_count > 0 && rules.face_up != fu::ALL)
-        turn_face_down_cards(moves);
-
-    if (rules.accordion_size > 0)
-        add_accordion_moves(moves);
-
-    return moves;
+// The last of the empty cells, or 255 if there are none
+pile::ref game_state::get_empty_cell() const {
+    pile::ref empty_cell = 255;
+    for (auto c : cells) {
+        if (piles[c].empty()) empty_cell = c;
+    }
+    return empty_cell;
 }
 
 
@@ -302,7 +399,13 @@ void game_state::add_stock_to_tableau_moves(std::vector<move>& moves) const {
         card from = stock_card_from_count(k_plus_mv.first);
 
         // Obeys the auto-reserve restriction unless the reserve is empty
-        if (!piles[reserve.front()].empty() && tableau_space_and_auto_reserve()) return;
+        if (!reserve.empty() && !piles[reserve.front()].empty() && tableau_space_and_auto_reserve()) return;
+
+        if (top_card_index) {
+            add_indexed_tableau_moves(moves, move(move::mtype::stock_k_plus, stock, 255, k_plus_mv.first, false, k_plus_mv.second),
+                                      tableau_targets(from));
+            continue;
+        }
 
         for (auto t : tableau_piles) {
             if (is_valid_tableau_move(from, t)) {
@@ -335,7 +438,7 @@ card game_state::stock_card_from_count(int8_t count) const {
 
 void game_state::add_foundation_complete_piles_moves(std::vector<move>& moves) const {
     for (pile::ref tab_pr : tableau_piles) {
-        if (is_ordered_pile(tab_pr)) {
+        if (piles[tab_pr].is_ordered(rules.max_rank)) {
 
             for (pile::ref found_pr : foundations) {
                 if (piles[found_pr].empty()) {
@@ -347,7 +450,10 @@ void game_state::add_foundation_complete_piles_moves(std::vector<move>& moves) c
     }
 }
 
-bool game_state::is_valid_tableau_move(const pile::ref rem_ref,
+// The checks below are called in the inner loops of every engine, and are
+// marked inline so that the compiler doesn't stop inlining them once it has
+// inlined them into a few
+inline bool game_state::is_valid_tableau_move(const pile::ref rem_ref,
                                        const pile::ref add_ref) const {
     if (rem_ref == add_ref || rules.build_pol == pol::NO_BUILD)
         return false;
@@ -355,7 +461,7 @@ bool game_state::is_valid_tableau_move(const pile::ref rem_ref,
     return is_valid_tableau_move(piles[rem_ref].top_card(), add_ref);
 }
 
-bool game_state::is_valid_tableau_move(const card rem_c,
+inline bool game_state::is_valid_tableau_move(const card rem_c,
                                        const pile::ref add_ref) const {
     if (piles[add_ref].empty()) {
         switch(rules.spaces_pol) {
@@ -373,18 +479,18 @@ bool game_state::is_valid_tableau_move(const card rem_c,
     }
 }
 
-bool game_state::is_next_tableau_card(card a, card b) const {
-    return is_next_legal_card(rules.build_pol, a, b);
+inline bool game_state::is_next_tableau_card(card a, card b) const {
+    return is_related(relations->tableau, a, b);
 }
 
-bool game_state::is_valid_foundations_move(const pile::ref rem_ref,
+inline bool game_state::is_valid_foundations_move(const pile::ref rem_ref,
                                            const pile::ref add_ref) const {
     if (rem_ref == add_ref || rules.foundations_only_comp_piles) return false;
 
     return is_valid_foundations_move(piles[rem_ref].top_card(), add_ref);
 }
 
-bool game_state::is_valid_foundations_move(const card rem_c,
+inline bool game_state::is_valid_foundations_move(const card rem_c,
                                            const pile::ref add_ref) const {
     if (piles[add_ref].size() == rules.max_rank) return false;
 
@@ -397,27 +503,16 @@ bool game_state::is_valid_foundations_move(const card rem_c,
     if (piles[add_ref].empty())
         return rem_c.get_rank() == foundations_base;
     else
-        return rem_c.get_rank() == (piles[add_ref].top_card().get_rank() % rules.max_rank) + 1;
+        return is_related(relations->foundation, piles[add_ref].top_card(), rem_c);
 }
 
-bool game_state::is_valid_hole_move(const pile::ref rem_ref) const {
+inline bool game_state::is_valid_hole_move(const pile::ref rem_ref) const {
     if (rem_ref == hole) return false;
     return is_valid_hole_move(piles[rem_ref].top_card());
 }
 
-bool game_state::is_valid_hole_move(const card c) const {
-    card::rank_t rank = c.get_rank();
-    card::rank_t hole_rank = piles[hole].top_card().get_rank();
-    
-    bool one_diff = (rank + 1 == hole_rank) || (rank == hole_rank + 1);
-    
-    if (!rules.hole_build_loops) {
-        return one_diff;
-    } else {
-        bool loop_one_diff = (rank == rules.max_rank && hole_rank == 1) 
-                || (rank == 1 && hole_rank == rules.max_rank);
-        return one_diff || loop_one_diff;
-    }
+inline bool game_state::is_valid_hole_move(const card c) const {
+    return is_related(relations->hole, piles[hole].top_card(), c);
 }
 
 
@@ -428,6 +523,13 @@ bool game_state::is_valid_hole_move(const card c) const {
 void game_state::add_valid_tableau_moves(std::vector<move>& moves, pile::ref from) const {
     if (tableau_space_and_auto_reserve()) return;
 
+    if (top_card_index) {
+        uint64_t targets = tableau_targets(piles[from].top_card());
+        if (is_tableau(from)) targets &= ~(uint64_t(1) << (from - original_tableau_piles.front()));
+        add_indexed_tableau_moves(moves, move(move::mtype::regular, from), targets);
+        return;
+    }
+
     for (auto to : tableau_piles) {
         if (is_valid_tableau_move(from, to)) {
             moves.emplace_back(move::mtype::regular, from, to);
@@ -435,6 +537,45 @@ void game_state::add_valid_tableau_moves(std::vector<move>& moves, pile::ref fro
     }
 }
 
+// The tableau piles a card can be moved to, as a mask of piles. The piles
+// topped by each card it can go on are found from the index, and the empty
+// piles are added if the spaces policy allows
+inline uint64_t game_state::tableau_targets(card c) const {
+    uint64_t targets = 0;
+    for (uint64_t tops = tableau_tops & relations->tableau_onto[relation_index(c)]; tops != 0; tops &= tops - 1)
+        targets |= tableau_top_piles[__builtin_ctzll(tops)];
+
+    switch (rules.spaces_pol) {
+        case sol_rules::spaces_policy::NO_BUILD:
+            break;
+        case sol_rules::spaces_policy::KINGS:
+            if (c.get_rank() == 13) targets |= empty_tableau_piles;
+            break;
+        default:
+            targets |= empty_tableau_piles;
+    }
+    return targets;
+}
+
+// Adds a copy of the move to each of the target piles, in the order of the
+// tableau pile refs so that the moves are the same as the pairwise checks
+void game_state::add_indexed_tableau_moves(vector<move>& moves, move m, uint64_t targets) const {
+    if (targets == 0) return;
+
+    if ((targets & (targets - 1)) == 0) {
+        m.to = pile::ref(original_tableau_piles.front() + __builtin_ctzll(targets));
+        moves.push_back(m);
+        return;
+    }
+
+    for (auto to : tableau_piles) {
+        if ((targets >> (to - original_tableau_piles.front())) & 1) {
+            m.to = to;
+            moves.push_back(m);
+        }
+    }
+}
+
 void game_state::add_built_group_moves(vector<move>& moves, bool only_maximal, bool card_above_buildable) const {
     assert(rules.built_group_pol != pol::NO_BUILD);
     if (tableau_space_and_auto_reserve()) return;
@@ -445,13 +586,13 @@ void game_state::add_built_group_moves(vector<move>& moves, bool only_maximal, b
 	// if enforcing maximal piles or enforcing check on card above pile then allow size one groups
         if (only_maximal || card_above_buildable) {
             if (piles[rem_ref].size() == 0) continue;
-            auto built_group_height = get_built_group_height(rem_ref);
+            auto built_group_height = piles[rem_ref].built_group_height();
             add_built_group_moves(moves, rem_ref, built_group_height, only_maximal, card_above_buildable); 
         } 
 	// otherwise size 1 groups are single cards and found elsewhere
         else { 
             if (piles[rem_ref].size() < 2) continue;
-            auto built_group_height = get_built_group_height(rem_ref);
+            auto built_group_height = piles[rem_ref].built_group_height();
             if (built_group_height == 1) continue;
             add_built_group_moves(moves, rem_ref, built_group_height, only_maximal, card_above_buildable);
         }
@@ -490,7 +631,8 @@ void game_state::add_whole_pile_moves(vector<move>& moves) const {
 
     // Cycles through each pile to see if it contains a whole-pile built group
     for (auto rem_ref : tableau_piles) {
-        auto built_group_height = get_built_group_height(rem_ref);
+        if (piles[rem_ref].empty()) continue;
+        auto built_group_height = piles[rem_ref].built_group_height();
 
         if (built_group_height == piles[rem_ref].size()) {
             add_whole_pile_moves(moves, rem_ref, built_group_height);
@@ -515,18 +657,8 @@ void game_state::add_whole_pile_moves(vector<move>& moves, pile::ref rem_ref, pi
     }
 }
 
-// Finds the size of the built group at the top of a pile
-pile::size_type game_state::get_built_group_height(pile::ref ref) const {
-    pile::size_type i = 1;
-    while (i < piles[ref].size()
-           && is_next_built_group_card(piles[ref][i], piles[ref][i-1])
-           && !piles[ref][i].is_face_down())
-        i++;
-    return i;
-}
-
 bool game_state::is_next_built_group_card(card a, card b) const {
-    return is_next_legal_card(rules.built_group_pol, a, b);
+    return is_related(relations->built_group, a, b);
 }
 
 // Loops through each possible built group move to an empty pile and adds it to the list
@@ -579,72 +711,90 @@ void game_state::add_non_empty_built_group_move(vector<move>& moves, pile::ref r
 
 void game_state::add_sequence_moves(std::vector<move>& moves) const {
     // Note, the sequence moves are encoded by counting each card's location (1-52) and adding that into 'to' and 'from'
-
-    // Finds the spaces
-    vector<pair<uint8_t, uint8_t>> space_locations;
-    for (pile::ref i = 0; i < sequences.size(); i++) {
-
-        for (pile::ref j = piles[sequences[i]].size(); j --> 0 ;) {
-            if (piles[sequences[i]][j] == "AS") {
-                space_locations.emplace_back(i, j);
+    const pile::size_type seq_size = piles[sequences.front()].size();
+
+    // Orders the moves as a scan of every card, left to right, would, so the
+    // order the moves are tried in doesn't depend on the lookup order
+    struct sequence_move {
+        uint16_t from_key;
+        uint16_t space_key;
+        move mv;
+    };
+    vector<sequence_move> seq_moves;
+
+    auto is_sequence = [&](pile::ref pr) {
+        return pr >= sequences.front() && pr < sequences.front() + sequences.size();
+    };
+
+    // Adds the moves of each card with the given rank that meets the condition
+    // into the space
+    auto add_cards_of_rank = [&](int rank, pile::ref space_seq, pile::size_type space_pos, std::function<bool(card)> legal) {
+        if (rank < 2 || rank > rules.max_rank) return; // The aces are the spaces
+        for (card::suit_t suit = 0; suit < 4; suit++) {
+            card from_card(suit, card::rank_t(rank));
+            if (!legal(from_card)) continue;
+
+            auto slots = find_card(from_card);
+            for (auto l = slots.first; l != slots.second; l++) {
+                if (l->pr == 255 || !is_sequence(l->pr)) continue;
+
+                pile::ref from_seq = pile::ref(l->pr - sequences.front());
+                pile::ref from_idx = from_seq * seq_size + (seq_size - 1 - l->pos); // Encoded index of card to be moved
+                pile::ref space_idx = space_seq * seq_size + (seq_size - 1 - space_pos); // Encoded index of space
+                seq_moves.push_back({uint16_t(from_seq * seq_size + l->pos), uint16_t(space_seq * seq_size + space_pos),
+                                     move(move::mtype::sequence, from_idx, space_idx)});
             }
         }
-    }
-
-    // Searches through the cards again to find valid moves into the spaces
-    for (pile::ref i = 0; i < sequences.size(); i++) {
-        for (pile::ref j = piles[sequences[i]].size(); j --> 0 ;) {
-            pile::ref from_idx = i * piles[sequences[i]].size() + j; // Encoded index of card to be moved
-            card from_card = piles[sequences[i]][j];
-            if (from_card == "AS") continue;
-
-            // Adds valid moves
-            for (pair<uint8_t, uint8_t> space_loc : space_locations) {
-                pile::ref space_idx = space_loc.first * piles[sequences[i]].size() + space_loc.second; // Encoded index of space
-
-                if (rules.sequence_direction == dir::LEFT || rules.sequence_direction == dir::BOTH) {
-                    // Only twos in the far left column
-                    if (space_loc.second == piles[sequences[i]].size() - 1) {
-                        if (from_card.get_rank() == 2) {
-                            bool is_legal = false;
-
-                            if (rules.sequence_fixed_suit) {
-                                if (from_card.get_suit() == space_loc.first) {
-                                    is_legal = true;
-                                }
-                            } else {
-                                is_legal = true;
-                            }
-
-                            if (is_legal) {
-                                moves.emplace_back(move::mtype::sequence, from_idx, space_idx);
-                            }
-                        }
-                    }
-                    // Otherwise must agree with left neighbour
-                    else {
-                        card neighbour_card = piles[sequences[space_loc.first]][space_loc.second + 1];
-                        if (neighbour_card != "AS" && is_next_legal_card(rules.sequence_build_pol, from_card, neighbour_card))
-                            moves.emplace_back(move::mtype::sequence, from_idx, space_idx);
-                    }
+    };
+
+    // Looks up the spaces, then the cards which can be moved into each
+    auto spaces = find_card("AS");
+    for (auto space = spaces.first; space != spaces.second; space++) {
+        if (space->pr == 255 || !is_sequence(space->pr)) continue;
+
+        pile::ref space_seq = pile::ref(space->pr - sequences.front());
+        pile::size_type space_pos = space->pos;
+        const pile& seq = piles[space->pr];
+
+        if (rules.sequence_direction == dir::LEFT || rules.sequence_direction == dir::BOTH) {
+            // Only twos in the far left column
+            if (space_pos == 0) {
+                add_cards_of_rank(2, space_seq, space_pos, [&](card from_card) {
+                    return !rules.sequence_fixed_suit || from_card.get_suit() == space_seq;
+                });
+            }
+            // Otherwise must agree with left neighbour
+            else {
+                card neighbour_card = seq[pile::size_type(seq_size - space_pos)];
+                if (neighbour_card != "AS") {
+                    add_cards_of_rank(neighbour_card.get_rank() + 1, space_seq, space_pos, [&](card from_card) {
+                        return is_related(relations->sequence, from_card, neighbour_card);
+                    });
                 }
+            }
+        }
 
-                if (rules.sequence_direction == dir::RIGHT || rules.sequence_direction == dir::BOTH) {
-                    // Only max rank in the far right column
-                    if (space_loc.second == 0) {
-                        if (from_card.get_rank() == rules.max_rank)
-                            moves.emplace_back(move::mtype::sequence, from_idx, space_idx);
-                    }
-                    // Otherwise must agree with right neighbour
-                    else {
-                        card neighbour_card = piles[sequences[space_loc.first]][space_loc.second - 1];
-                        if (neighbour_card != "AS" && is_next_legal_card(rules.sequence_build_pol, neighbour_card, from_card))
-                            moves.emplace_back(move::mtype::sequence, from_idx, space_idx);
-                    }
+        if (rules.sequence_direction == dir::RIGHT || rules.sequence_direction == dir::BOTH) {
+            // Only max rank in the far right column
+            if (space_pos == seq_size - 1) {
+                add_cards_of_rank(rules.max_rank, space_seq, space_pos, [](card) { return true; });
+            }
+            // Otherwise must agree with right neighbour
+            else {
+                card neighbour_card = seq[pile::size_type(seq_size - 2 - space_pos)];
+                if (neighbour_card != "AS") {
+                    add_cards_of_rank(neighbour_card.get_rank() - 1, space_seq, space_pos, [&](card from_card) {
+                        return is_related(relations->sequence, neighbour_card, from_card);
+                    });
                 }
             }
         }
     }
+
+    std::stable_sort(begin(seq_moves), end(seq_moves), [](const sequence_move& a, const sequence_move& b) {
+        return a.from_key != b.from_key ? a.from_key < b.from_key : a.space_key < b.space_key;
+    });
+    for (const sequence_move& sm : seq_moves) moves.push_back(sm.mv);
 }
 
 void game_state::add_accordion_moves(vector<move>& moves) const {
@@ -661,7 +811,7 @@ void game_state::add_accordion_moves(vector<move>& moves) const {
                 continue;
             }
 
-            if (is_next_legal_card(rules.accordion_pol, piles[*to_it].top_card(), piles[*from_it].top_card()))
+            if (is_related(relations->accordion, piles[*to_it].top_card(), piles[*from_it].top_card()))
                 moves.emplace_back(move::mtype::accordion, *from_it, *to_it, piles[*from_it].size());
         }
     }
@@ -692,6 +842,57 @@ bool game_state::tableau_space_and_auto_reserve() const {
 
 ///////////////////////
 
+// Precomputes which cards can go on which for each of the game's relations,
+// so that checking a pair of cards is a single lookup. Depends on the
+// foundations base, so is redone whenever it is set
+void game_state::init_card_relations() {
+    auto rels = std::make_shared<card_relations>();
+
+    auto one_apart = [&](card::rank_t a, card::rank_t b) {
+        bool one_diff = (a + 1 == b) || (a == b + 1);
+        bool loop_one_diff = (a == rules.max_rank && b == 1) || (a == 1 && b == rules.max_rank);
+        return one_diff || (rules.hole_build_loops && loop_one_diff);
+    };
+
+    for (auto rel : {&rels->tableau, &rels->tableau_onto, &rels->built_group, &rels->sequence,
+                     &rels->accordion, &rels->foundation, &rels->hole})
+        rel->fill(0);
+
+    for (card::suit_t a_suit = 0; a_suit < 4; a_suit++) {
+        for (card::rank_t a_rank = 1; a_rank <= rules.max_rank; a_rank++) {
+            card a(a_suit, a_rank);
+            uint8_t a_idx = relation_index(a);
+
+            for (card::suit_t b_suit = 0; b_suit < 4; b_suit++) {
+                for (card::rank_t b_rank = 1; b_rank <= rules.max_rank; b_rank++) {
+                    card b(b_suit, b_rank);
+                    uint64_t bit = uint64_t(1) << relation_index(b);
+
+                    if (is_next_legal_card(rules.build_pol, a, b)) {
+                        rels->tableau[a_idx] |= bit;
+                        rels->tableau_onto[relation_index(b)] |= uint64_t(1) << a_idx;
+                    }
+                    if (is_next_legal_card(rules.built_group_pol, a, b))    rels->built_group[a_idx] |= bit;
+                    if (is_next_legal_card(rules.sequence_build_pol, a, b)) rels->sequence[a_idx] |= bit;
+                    if (is_next_legal_card(rules.accordion_pol, a, b))      rels->accordion[a_idx] |= bit;
+                    if (b_rank == a_rank % rules.max_rank + 1)              rels->foundation[a_idx] |= bit;
+                    if (one_apart(a_rank, b_rank))                          rels->hole[a_idx] |= bit;
+                }
+            }
+        }
+    }
+
+    relations = rels;
+}
+
+uint8_t game_state::relation_index(card c) {
+    return uint8_t(c.get_suit() << 4 | c.get_rank());
+}
+
+bool game_state::is_related(const card_relation& rel, card a, card b) {
+    return (rel[relation_index(a)] >> relation_index(b)) & 1;
+}
+
 bool game_state::is_next_legal_card(pol p, card a, card b) const {
     // Checks build pol violations
     switch(p) {
@@ -711,7 +912,7 @@ bool game_state::is_next_legal_card(pol p, card a, card b) const {
     return b_rank + 1 == a_rank;
 }
 
-bool game_state::is_next_legal_card(vector<acc_pol> vp, card a, card b) const {
+bool game_state::is_next_legal_card(const vector<acc_pol>& vp, card a, card b) const {
     for (auto p : vp) {
         switch (p) {
             case sol_rules::accordion_policy::SAME_RANK:
@@ -730,11 +931,11 @@ bool game_state::is_next_legal_card(vector<acc_pol> vp, card a, card b) const {
     return false;
 }
 
-void game_state::turn_face_down_cards(vector<move>& moves) const {
-    for (auto& m : moves) {
-        bool is_tableau_move = m.from >= original_tableau_piles.front() && m.from <= original_tableau_piles.back();
-        if (is_tableau_move && piles[m.from].size() > 1 && piles[m.from][1].is_face_down()) {
-            m.make_reveal_move();
+void game_state::turn_face_down_cards(vector<move>& moves, vector<move>::size_type first_move) const {
+    for (auto m = begin(moves) + first_move; m != end(moves); m++) {
+        bool is_tableau_move = m->from >= original_tableau_piles.front() && m->from <= original_tableau_piles.back();
+        if (is_tableau_move && piles[m->from].size() > 1 && piles[m->from][1].is_face_down()) {
+            m->make_reveal_move();
         }
     }
 }
@@ -24,10 +24,7 @@
 #include <algorithm>
 #include "game_state.h"
 
-using std::list;
 using std::find;
-using std::rbegin;
-using std::rend;
 
 // Assesses whether the pile ref that was modified was a tableau, cell or
 // reserve pile, and if so makes the relevant function call
@@ -50,51 +47,27 @@ void game_state::eval_pile_order(pile::ref pr, bool is_place) {
     }
 }
 
-// Finds the pile ref in the list and evaluates whether it should be moved to
-// maintain the "pile order"
-void game_state::eval_pile_order(list<pile::ref>& pile_lst, pile::ref changed_pr,
+// Finds the pile ref in the order and evaluates whether it should be moved to
+// maintain the "pile order", largest pile first
+void game_state::eval_pile_order(ordered_piles& order, pile::ref changed_pr,
                                  bool is_place) {
-    // Finds the first pile that is larger/smaller than the ref pile
-    // (the comp pile).
-    // If the card has been placed, search for the ref from the right hand side
-    // and if not from the lhs
-    if (is_place) {
-        auto changed_ref_iter = find(rbegin(pile_lst), rend(pile_lst), changed_pr);
-        auto comp_iter = changed_ref_iter;
-
-        while (++comp_iter != rend(pile_lst)
-               && piles[*comp_iter] < piles[*changed_ref_iter]);
+    // If the card has been placed the pile can only have grown, so moves
+    // forward past any smaller piles, and if not backwards past larger ones
+    auto changed_idx = ordered_piles::size_type(find(order.begin(), order.end(), changed_pr) - order.begin());
+    auto comp_idx = changed_idx;
 
-        if (comp_iter != ++changed_ref_iter) {
-            // Places the ref pile before the comp pile
-            pile_lst.insert(comp_iter.base(), changed_pr);
-            pile_lst.erase(changed_ref_iter.base());
-        }
+    if (is_place) {
+        while (comp_idx > 0 && piles[order[comp_idx - 1]] < piles[changed_pr]) comp_idx--;
     } else {
-        auto changed_ref_iter = find(begin(pile_lst), end(pile_lst), changed_pr);
-        auto comp_iter = changed_ref_iter;
-
-        while (++comp_iter != end(pile_lst)
-               && piles[*comp_iter] > piles[*changed_ref_iter]);
-
-        if (comp_iter != ++changed_ref_iter) {
-            // Places the ref pile before the comp pile
-            pile_lst.insert(comp_iter, changed_pr);
-            pile_lst.erase(--changed_ref_iter);
-        }
+        while (comp_idx + 1 < order.size() && piles[order[comp_idx + 1]] > piles[changed_pr]) comp_idx++;
     }
 
+    if (comp_idx != changed_idx) order.reposition(changed_idx, comp_idx);
+
 #ifndef NDEBUG
     // Makes sure the piles are in order
-    if (pile_lst.size() > 1) {
-        auto prev = begin(pile_lst);
-        auto cur = begin(pile_lst);
-        cur++;
-
-        while (cur != end(pile_lst)) {
-            assert(piles[*prev] >= piles[*cur]);
-            prev++; cur++;
-        }
+    for (ordered_piles::size_type i = 1; i < order.size(); i++) {
+        assert(piles[order[i - 1]] >= piles[order[i]]);
     }
 #endif
 }
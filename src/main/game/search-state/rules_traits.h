@@ -0,0 +1,133 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_RULES_TRAITS_H
+#define SOLVITAIRE_RULES_TRAITS_H
+
+#include "../sol_rules.h"
+
+// The questions the move generator asks of the rules. The generic traits read
+// the answers from the rules as it runs. The traits for the presets solved
+// most often fix them at compile time instead, so that the move generator
+// built with them has no branches for rules those games never use. A game
+// state only uses them if its rules give the same answers
+struct generic_traits {
+    typedef sol_rules::stock_deal_type sdt;
+    typedef sol_rules::built_group_type bgt;
+
+    static bool hole(const sol_rules& r)                        { return r.hole; }
+    static bool cells(const sol_rules& r)                       { return r.cells > 0; }
+    static bool stock(const sol_rules& r)                       { return r.stock_size > 0; }
+    static sdt stock_deal_t(const sol_rules& r)                 { return r.stock_deal_t; }
+    static bool stock_redeal(const sol_rules& r)                { return r.stock_redeal; }
+    static bool foundations_present(const sol_rules& r)         { return r.foundations_present; }
+    static bool foundations_only_comp_piles(const sol_rules& r) { return r.foundations_only_comp_piles; }
+    static bool foundations_removable(const sol_rules& r)       { return r.foundations_removable; }
+    static bool reserve(const sol_rules& r)                     { return r.reserve_size > 0; }
+    static bool sequences(const sol_rules& r)                   { return r.sequence_count > 0; }
+    static bool accordion(const sol_rules& r)                   { return r.accordion_size > 0; }
+    static bgt move_built_group(const sol_rules& r)             { return r.move_built_group; }
+    static bool face_down_cards(const sol_rules& r) {
+        return r.tableau_pile_count > 0 && r.face_up != sol_rules::face_up_policy::ALL;
+    }
+};
+
+// The answers for the default rules: a tableau of face up cards and the
+// foundations, with nothing else
+struct default_traits {
+    typedef sol_rules::stock_deal_type sdt;
+    typedef sol_rules::built_group_type bgt;
+
+    static constexpr bool hole(const sol_rules&)                        { return false; }
+    static constexpr bool cells(const sol_rules&)                       { return false; }
+    static constexpr bool stock(const sol_rules&)                       { return false; }
+    static constexpr sdt stock_deal_t(const sol_rules&)                 { return sdt::WASTE; }
+    static constexpr bool stock_redeal(const sol_rules&)                { return false; }
+    static constexpr bool foundations_present(const sol_rules&)         { return true; }
+    static constexpr bool foundations_only_comp_piles(const sol_rules&) { return false; }
+    static constexpr bool foundations_removable(const sol_rules&)       { return false; }
+    static constexpr bool reserve(const sol_rules&)                     { return false; }
+    static constexpr bool sequences(const sol_rules&)                   { return false; }
+    static constexpr bool accordion(const sol_rules&)                   { return false; }
+    static constexpr bgt move_built_group(const sol_rules&)             { return bgt::NO; }
+    static constexpr bool face_down_cards(const sol_rules&)             { return false; }
+};
+
+// Each of the traits below only gives the answers that differ from the
+// default rules
+
+// Klondike
+struct klondike_traits : default_traits {
+    static constexpr bool stock(const sol_rules&)                       { return true; }
+    static constexpr bool stock_redeal(const sol_rules&)                { return true; }
+    static constexpr bool foundations_removable(const sol_rules&)       { return true; }
+    static constexpr bgt move_built_group(const sol_rules&)             { return bgt::PARTIAL_IF_CARD_ABOVE_BUILDABLE; }
+    static constexpr bool face_down_cards(const sol_rules&)             { return true; }
+};
+
+// Free Cell and Baker's Game, which differ only in their build policy
+struct free_cell_traits : default_traits {
+    static constexpr bool cells(const sol_rules&)                       { return true; }
+};
+
+// Canfield
+struct canfield_traits : default_traits {
+    static constexpr bool stock(const sol_rules&)                       { return true; }
+    static constexpr bool stock_redeal(const sol_rules&)                { return true; }
+    static constexpr bool reserve(const sol_rules&)                     { return true; }
+    static constexpr bgt move_built_group(const sol_rules&)             { return bgt::PARTIAL_IF_CARD_ABOVE_BUILDABLE; }
+};
+
+// Spider and Spiderette. Their presets ask for only complete piles to be moved
+// to the foundations, but under a key the rules parser doesn't read, so these
+// are the rules they are actually solved with
+struct spider_traits : default_traits {
+    static constexpr bool stock(const sol_rules&)                       { return true; }
+    static constexpr sdt stock_deal_t(const sol_rules&)                 { return sdt::TABLEAU_PILES; }
+    static constexpr bgt move_built_group(const sol_rules&)             { return bgt::YES; }
+    static constexpr bool face_down_cards(const sol_rules&)             { return true; }
+};
+
+// Black Hole
+struct black_hole_traits : default_traits {
+    static constexpr bool hole(const sol_rules&)                        { return true; }
+    static constexpr bool foundations_present(const sol_rules&)         { return false; }
+};
+
+// Whether the traits give the same answers as the rules
+template<class R>
+bool traits_match(const sol_rules& r) {
+    typedef generic_traits g;
+    return R::hole(r) == g::hole(r)
+           && R::cells(r) == g::cells(r)
+           && R::stock(r) == g::stock(r)
+           && R::stock_deal_t(r) == g::stock_deal_t(r)
+           && R::stock_redeal(r) == g::stock_redeal(r)
+           && R::foundations_present(r) == g::foundations_present(r)
+           && R::foundations_only_comp_piles(r) == g::foundations_only_comp_piles(r)
+           && R::foundations_removable(r) == g::foundations_removable(r)
+           && R::reserve(r) == g::reserve(r)
+           && R::sequences(r) == g::sequences(r)
+           && R::accordion(r) == g::accordion(r)
+           && R::move_built_group(r) == g::move_built_group(r)
+           && R::face_down_cards(r) == g::face_down_cards(r);
+}
+
+#endif //SOLVITAIRE_RULES_TRAITS_H
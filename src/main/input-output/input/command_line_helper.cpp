@@ -21,6 +21,7 @@
 // Created by thecharlesblake on 10/16/17.
 //
 
+#include <cctype>
 #include <tuple>
 #include <vector>
 
@@ -60,6 +61,24 @@ command_line_helper::command_line_helper()
                          "classification")
             ("cache-capacity", po::value<uint64_t>(), "sets an upper bound on the number of states allowed in "
                                "the cache")
+            ("cache-type", po::value<string>(), "the structure used to cache visited states. Options are 'lru' "
+                           "(full states with least-recently-used eviction) and 'transposition-table' (64-bit "
+                           "fingerprints in a flat table, using far less memory per state) and 'shared-transposition-table' (a "
+                           "lock-free transposition table that solvers on several threads can search one deal with). "
+                           "Defaults to 'lru'")
+            ("cache-eviction", po::value<string>(), "how the 'lru' cache picks a state to evict when full. Options "
+                               "are 'lru' (least recently used), 'clock' (second-chance, which never has to "
+                               "pass over states still being searched) and 'cost' (least recently used, but keeping "
+                               "states whose subtrees took longer to search for longer). Defaults to 'lru'")
+            ("cache-memory", po::value<string>(), "sets an upper bound on the memory used by the cache, in bytes. "
+                             "Accepts a K, M or G suffix (e.g. '8G'). When reached, states are evicted from the "
+                             "cache rather than the search failing")
+            ("cache-dead-states", "keeps a 64-bit fingerprint of each state evicted from the 'lru' cache, so that "
+                                  "fully searched states are never searched again after eviction. As with the "
+                                  "transposition tables, a fingerprint collision could (very rarely) prune a state "
+                                  "that was never searched, so an unsolvable result may be wrong")
+            ("cache-huge-pages", "asks the OS to back the cache with transparent huge pages, which can reduce "
+                                 "TLB misses for large caches")
             ("solvability", po::value<int>(), "calculates the solvability "
                     "percentage of the supplied solitaire game, given a limit for the number of seeds. Must supply "
                     "either 'random', 'benchmark', 'solvability' or list of deals to be solved.")
@@ -67,19 +86,35 @@ command_line_helper::command_line_helper()
             ("resume", po::value<vector<int>>()->multitoken(), "resumes the solvability percentage calculation from a "
                                                     "previous run. Must be supplied with the solvability option. "
                                                     "Syntax: [sol unsol intract in-progress-1 in-progress-2 ...]")
-            ("cores", po::value<uint>(), "the number of cores for the solvability percentages to be run across. "
-                                         "Must be supplied with the solvability option.")
+            ("cores", po::value<uint>(), "the number of cores for the solvability percentages to be run across, "
+                                         "or the number of connections to a '--serve' socket answered at once. "
+                                         "Once no seeds are left to start, idle cores help search the ones still "
+                                         "in progress, joining their searches if the cache is the shared transposition "
+                                         "table, and racing the unused streamliners otherwise. Must be supplied with "
+                                         "the solvability or serve option.")
+            ("threads-per-deal", po::value<uint>(), "the number of threads that search each deal together, "
+                                                    "stealing unexplored moves from one another. With more than one, "
+                                                    "the threads share a 'shared-transposition-table' cache. "
+                                                    "Defaults to 1")
             ("streamliners", po::value<string>(),
                     "Applies streamliners to the search. Options include 'none', 'both', 'suit-symmetry',"
                     " 'auto-foundations', and 'smart-solvability'. Defaults to 'none', unless '--solvability' is"
                     " also supplied, in which case defaults to 'smart-solvability'. 'smart-solvability' mode"
-                    " runs first with both streamliners and a 10% timeout. If this"
-                    " is unsuccessful (unsolvable or timeout), then runs again without streamliners.")
+                    " races a search with both streamliners and a 10% timeout against one without"
+                    " streamliners, on a thread each. A solution from either, or the unstreamlined search"
+                    " finding the deal unsolvable, ends both. The two searches split the cache's capacity and"
+                    " memory between them, and in a solvability run both threads count against '--cores'.")
             ("benchmark", "outputs performance statistics for the solver on the "
                           "supplied solitaire game. Must supply "
                           "either 'random', 'benchmark', 'solvability' or list of deals to be "
                           "solved.")
-            ("deal-only", "outputs the starting deal for a given game type & random seed as json");
+            ("deal-only", "outputs the starting deal for a given game type & random seed as json")
+            ("serve", po::value<string>()->implicit_value("-"), "keeps running, solving the deals it is sent. Each "
+                      "request is a JSON object on a line of its own, giving a 'seed' or a 'deal' and optionally a "
+                      "'type', 'timeout', 'streamliners' and an 'id' to be sent back. The rest default to the options "
+                      "given here, and 'type' or 'custom-rules' may be left out. Each is answered with a line holding "
+                      "a JSON object with the fields of the 'classify' output. Reads requests from the standard input, "
+                      "unless given the path of a Unix socket to listen on");
 
     po::options_description hidden_options("Hidden options");
     hidden_options.add_options()
@@ -146,6 +181,47 @@ bool command_line_helper::parse(int argc, const char* argv[]) {
         cache_capacity = 100000000; // One hundred-million
     }
 
+    if (vm.count("cache-type")) {
+        auto& s = vm["cache-type"].as<string>();
+
+        if (s == "lru") cache_type = state_cache::backend::LRU;
+        else if (s == "transposition-table") cache_type = state_cache::backend::TRANSPOSITION_TABLE;
+        else if (s == "shared-transposition-table") cache_type = state_cache::backend::SHARED_TRANSPOSITION_TABLE;
+        else {
+            print_cache_type_error(s);
+            return false;
+        }
+    } else {
+        cache_type = state_cache::backend::LRU;
+    }
+
+    if (vm.count("cache-eviction")) {
+        auto& s = vm["cache-eviction"].as<string>();
+
+        if (s == "lru") cache_eviction = state_cache::eviction_policy::LRU;
+        else if (s == "clock") cache_eviction = state_cache::eviction_policy::CLOCK;
+        else if (s == "cost") cache_eviction = state_cache::eviction_policy::COST;
+        else {
+            print_cache_eviction_error(s);
+            return false;
+        }
+    } else {
+        cache_eviction = state_cache::eviction_policy::LRU;
+    }
+
+    if (vm.count("cache-memory")) {
+        auto& s = vm["cache-memory"].as<string>();
+
+        auto bytes = parse_memory_size(s);
+        if (!bytes) {
+            print_cache_memory_error(s);
+            return false;
+        }
+        cache_memory = *bytes;
+    } else {
+        cache_memory = 0;
+    }
+
     if (vm.count("solvability")) {
         solvability = vm["solvability"].as<int>();
     } else {
@@ -164,6 +240,12 @@ bool command_line_helper::parse(int argc, const char* argv[]) {
         cores = 1;
     }
 
+    if (vm.count("threads-per-deal")) {
+        threads_per_deal = vm["threads-per-deal"].as<uint>();
+    } else {
+        threads_per_deal = 1;
+    }
+
     if (vm.count("resume")) {
         resume = vm["resume"].as<vector<int>>();
     } else {
@@ -174,21 +256,24 @@ bool command_line_helper::parse(int argc, const char* argv[]) {
     if (vm.count("streamliners")) {
         auto& s = vm["streamliners"].as<string>();
 
-        if (s == "auto-foundations" ) streamliners = streamliner_opt::AUTO_FOUNDATIONS;
-        else if (s == "suit-symmetry") streamliners = streamliner_opt::SUIT_SYMMETRY;
-        else if (s == "both") streamliners = streamliner_opt::BOTH;
-        else if (s == "smart-solvability") streamliners = streamliner_opt::SMART;
-        else if (s == "none") streamliners = streamliner_opt::NONE;
-        else {
+        auto opt = parse_streamliners(s);
+        if (!opt) {
             print_streamliner_error(s);
             return false;
         }
+        streamliners = *opt;
     } else {
         if (solvability == -1) streamliners = streamliner_opt::NONE;
         else streamliners = streamliner_opt::SMART;
     }
 
+    if (vm.count("serve")) {
+        serve = vm["serve"].as<string>();
+    }
+
     benchmark = (vm.count("benchmark") != 0);
+    cache_huge_pages = (vm.count("cache-huge-pages") != 0);
+    cache_dead_states = (vm.count("cache-dead-states") != 0);
 
     // Handle logic error scenarios
     return assess_errors();
@@ -211,7 +296,7 @@ bool command_line_helper::assess_errors() {
 
     // The user must either supply input files, a random seed, or ask for the
     // solvability percentage, or benchmark
-    int opt_count = (random_deal != -1) + !input_files.empty() + (solvability > 0) + benchmark;
+    int opt_count = (random_deal != -1) + !input_files.empty() + (solvability > 0) + benchmark + !serve.empty();
 
     if (opt_count > 1) {
         print_too_many_opts_error();
@@ -221,8 +306,9 @@ bool command_line_helper::assess_errors() {
         return false;
     }
 
-    // The user must supply either a solitaire type or a rules file
-    if ((solitaire_type.empty() && rules_file.empty())
+    // The user must supply either a solitaire type or a rules file, though
+    // when serving the requests can give the type instead
+    if ((solitaire_type.empty() && rules_file.empty() && serve.empty())
             || (!solitaire_type.empty() && !rules_file.empty())) {
         print_sol_type_rules_error();
         return false;
@@ -254,7 +340,7 @@ void command_line_helper::print_help() {
 
 void command_line_helper::print_no_opts_error() {
     LOG_ERROR ("Error: User must supply input file(s), the '--random' "
-            "option, the 'benchmark' option, or the '--solvability' option");
+            "option, the 'benchmark' option, the '--solvability' option, or the '--serve' option");
     print_help();
 }
 
@@ -265,8 +351,8 @@ void command_line_helper::print_sol_type_rules_error() {
 }
 
 void command_line_helper::print_too_many_opts_error() {
-    LOG_ERROR ("Error: User must supply input file(s), the '--random' option, the 'benchmark' option,, "
-               "or the '--solvability' option, not multiple");
+    LOG_ERROR ("Error: User must supply input file(s), the '--random' option, the 'benchmark' option, "
+               "the '--solvability' option, or the '--serve' option, not multiple");
     print_help();
 }
 
@@ -280,6 +366,40 @@ void command_line_helper::print_streamliner_error(const string& str) {
                                                       " 'auto-foundations', and 'smart-solvability'");
 }
 
+void command_line_helper::print_cache_type_error(const string& str) {
+    LOG_ERROR ("Error: invalid cache type: " + str + ".\nAvailable options are: 'lru', 'transposition-table' "
+               "and 'shared-transposition-table'");
+}
+
+void command_line_helper::print_cache_eviction_error(const string& str) {
+    LOG_ERROR ("Error: invalid cache eviction policy: " + str + ".\nAvailable options are: 'lru', 'clock' and 'cost'");
+}
+
+void command_line_helper::print_cache_memory_error(const string& str) {
+    LOG_ERROR ("Error: invalid cache memory: " + str + ".\nMust be a positive number of bytes, optionally followed by "
+               "K, M or G");
+}
+
+// Parses a number of bytes with an optional (binary) K, M or G suffix
+boost::optional<uint64_t> command_line_helper::parse_memory_size(const string& str) {
+    size_t digits = 0;
+    while (digits < str.size() && isdigit(static_cast<unsigned char>(str[digits]))) digits++;
+    if (digits == 0 || digits > 15 || str.size() - digits > 1) return boost::none;
+
+    uint64_t bytes = std::stoull(str.substr(0, digits));
+    if (digits < str.size()) {
+        switch (toupper(str[digits])) {
+            case 'K': bytes <<= 10; break;
+            case 'M': bytes <<= 20; break;
+            case 'G': bytes <<= 30; break;
+            default: return boost::none;
+        }
+    }
+
+    if (bytes == 0) return boost::none;
+    return bytes;
+}
+
 const vector<string> command_line_helper::get_input_files() {
     return input_files;
 }
@@ -308,6 +428,11 @@ uint64_t command_line_helper::get_cache_capacity() {
     return cache_capacity;
 }
 
+cache_options command_line_helper::get_cache_options() {
+    return cache_options(cache_capacity, cache_type, cache_eviction, cache_memory, cache_huge_pages,
+                         cache_dead_states);
+}
+
 int command_line_helper::get_solvability() {
     return solvability;
 }
@@ -324,6 +449,10 @@ uint command_line_helper::get_cores() {
     return cores;
 }
 
+uint command_line_helper::get_threads_per_deal() {
+    return threads_per_deal;
+}
+
 bool command_line_helper::get_available_game_types() {
     return available_game_types;
 }
@@ -336,6 +465,12 @@ bool command_line_helper::get_benchmark() {
     return benchmark;
 }
 
+// The path of the socket to serve on, '-' to serve on the standard input, or
+// empty if not serving
+const string command_line_helper::get_serve() {
+    return serve;
+}
+
 bool command_line_helper::get_version() {
     return version;
 }
@@ -361,3 +496,12 @@ game_state::streamliner_options command_line_helper::convert_streamliners(stream
             return game_state::streamliner_options::NONE;;
     }
 }
+
+boost::optional<command_line_helper::streamliner_opt> command_line_helper::parse_streamliners(const string& s) {
+    if (s == "auto-foundations" ) return streamliner_opt::AUTO_FOUNDATIONS;
+    else if (s == "suit-symmetry") return streamliner_opt::SUIT_SYMMETRY;
+    else if (s == "both") return streamliner_opt::BOTH;
+    else if (s == "smart-solvability") return streamliner_opt::SMART;
+    else if (s == "none") return streamliner_opt::NONE;
+    else return boost::none;
+}
@@ -25,7 +25,9 @@
 #define SOLVITAIRE_COMMAND_LINE_HELPER_H
 
 #include <boost/program_options.hpp>
+#include <boost/optional.hpp>
 #include "../../game/search-state/game_state.h"
+#include "../../game/global_cache.h"
 
 class command_line_helper {
 public:
@@ -41,16 +43,20 @@ public:
     bool get_deal_only();
     int get_solvability();
     uint get_cores();
+    uint get_threads_per_deal();
     bool get_available_game_types();
     bool get_benchmark();
+    const std::string get_serve();
     streamliner_opt get_streamliners();
     game_state::streamliner_options get_streamliners_game_state();
     std::vector<int> get_resume();
     uint64_t get_cache_capacity();
+    cache_options get_cache_options();
     std::string get_describe_game_rules();
     uint64_t get_timeout();
     bool get_version();
     static game_state::streamliner_options convert_streamliners(streamliner_opt);
+    static boost::optional<streamliner_opt> parse_streamliners(const std::string&);
 
 private:
     bool assess_errors();
@@ -61,6 +67,10 @@ private:
     void print_too_many_opts_error();
     void print_resume_error();
     void print_streamliner_error(const std::string&);
+    void print_cache_type_error(const std::string&);
+    void print_cache_eviction_error(const std::string&);
+    void print_cache_memory_error(const std::string&);
+    static boost::optional<uint64_t> parse_memory_size(const std::string&);
 
     boost::program_options::options_description cmdline_options;
     boost::program_options::options_description main_options;
@@ -77,11 +87,18 @@ private:
     int solvability;
     std::vector<int> resume;
     uint cores;
+    uint threads_per_deal;
     bool available_game_types;
     bool version;
     bool benchmark;
+    std::string serve;
     streamliner_opt streamliners;
     uint64_t cache_capacity;
+    state_cache::backend cache_type;
+    state_cache::eviction_policy cache_eviction;
+    uint64_t cache_memory;
+    bool cache_huge_pages;
+    bool cache_dead_states;
     uint64_t timeout;
 };
 
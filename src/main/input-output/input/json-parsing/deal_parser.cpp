@@ -21,6 +21,8 @@
 // Created by thecharlesblake on 10/21/17.
 //
 
+#include <algorithm>
+
 #include "deal_parser.h"
 #include "../../../game/search-state/game_state.h"
 #include "json_helper.h"
@@ -107,7 +109,7 @@ string deal_parser::deal_schema_json() {
   "description": "JSON Schema representing a solitaire game state to solve",
 
   "definitions": {
-    "card": {"type": "string", "pattern": "^(([0-9]|1[0-3]|a|A|j|J|q|Q|k|K)(c|C|d|D|h|H|s|S))$"},
+    "card": {"type": "string", "pattern": "^(([1-9]|1[0-3]|a|A|j|J|q|Q|k|K)(c|C|d|D|h|H|s|S))$"},
     "cardarray": {"type": "array", "items": {"$ref": "#/definitions/card"}},
     "cardarraywithempty": {
       "type": "array",
@@ -155,8 +157,7 @@ void deal_parser::parse_tableau_piles(game_state &gs, const rapidjson::Document&
          ++p.first, ++p.second) {
 
         for (auto& json_card : p.first->GetArray()) {
-            assert(json_card.IsString());
-            gs.place_card(*p.second, card(json_card.GetString(), gs.rules.face_up != fu::ALL));
+            place_card(gs, *p.second, parse_card(gs, json_card, gs.rules.face_up != fu::ALL));
         }
     }
 }
@@ -164,9 +165,8 @@ void deal_parser::parse_tableau_piles(game_state &gs, const rapidjson::Document&
 void deal_parser::parse_hole(game_state &gs, const Document& doc) {
     if (doc.HasMember("hole")) {
         const Value &json_hole = doc["hole"];
-        assert(json_hole.IsString());
 
-        gs.place_card(gs.hole, card(json_hole.GetString()));
+        place_card(gs, gs.hole, parse_card(gs, json_hole));
     }
 }
 
@@ -187,8 +187,7 @@ void deal_parser::parse_cells(game_state &gs, const Document& doc) {
              ++p.first, ++p.second) {
 
             auto json_card = p.first;
-            assert(json_card->IsString());
-            gs.place_card(*p.second, card(json_card->GetString()));
+            place_card(gs, *p.second, parse_card(gs, *json_card));
         }
     }
 }
@@ -199,8 +198,7 @@ void deal_parser::parse_stock(game_state &gs, const Document& doc) {
         assert(json_stock.IsArray());
 
         for (const Value& json_card : json_stock.GetArray()) {
-            assert(json_card.IsString());
-            gs.place_card(gs.stock, card(json_card.GetString()));
+            place_card(gs, gs.stock, parse_card(gs, json_card));
         }
     }
 }
@@ -211,8 +209,7 @@ void deal_parser::parse_waste(game_state &gs, const Document& doc) {
         assert(json_waste.IsArray());
 
         for (const Value& json_card : json_waste.GetArray()) {
-            assert(json_card.IsString());
-            gs.place_card(gs.waste, card(json_card.GetString()));
+            place_card(gs, gs.waste, parse_card(gs, json_card));
         }
     }
 }
@@ -223,14 +220,16 @@ void deal_parser::parse_reserve(game_state &gs, const Document& doc) {
     assert(json_reserve_piles.IsArray());
 
     const auto& json_card_arr = json_reserve_piles.GetArray();
+    if (!gs.rules.reserve_stacked && json_card_arr.Size() > gs.rules.reserve_size) {
+        json_helper::json_parse_err("Too many reserve cards");
+    }
 
     // We treat a regular reserve like multiple single-card piles,
     // but a stacked reserve as a single multiple-card pile
     for (pile::ref i = 0; i < json_card_arr.Size(); i++) {
-        assert(json_card_arr[i].IsString());
         pile::ref pr = gs.original_reserve[0];
         if (!gs.rules.reserve_stacked) pr += i;
-        gs.place_card(pr, card(json_card_arr[i].GetString()));
+        place_card(gs, pr, parse_card(gs, json_card_arr[i]));
     }
 }
 
@@ -248,10 +247,10 @@ void deal_parser::parse_sequences(game_state& gs, const rapidjson::Document& doc
          ++p.first, ++p.second) {
 
         for (auto& json_card : p.first->GetArray()) {
-            assert(json_card.IsString());
-            string card_str = json_card.GetString();
-            card c = card_str.empty() ? "AS" : card(json_card.GetString());
-            gs.place_card(*p.second, c);
+            // An empty string is a gap, which is dealt as an ace
+            bool gap = json_card.IsString() && json_card.GetStringLength() == 0;
+            card c = gap ? "AS" : parse_card(gs, json_card);
+            place_card(gs, *p.second, c);
         }
     }
 }
@@ -271,9 +270,8 @@ void deal_parser::parse_accordion(game_state &gs, const Document& doc) {
 
     auto acc_it = begin(gs.accordion);
     for (pile::ref i = 0; i < json_card_arr.Size(); i++, acc_it++) {
-        assert(json_card_arr[i].IsString());
         pile::ref pr = *acc_it;
-        gs.place_card(pr, card(json_card_arr[i].GetString()));
+        place_card(gs, pr, parse_card(gs, json_card_arr[i]));
     }
 }
 
@@ -285,15 +283,14 @@ bool deal_parser::parse_foundations(game_state &gs, const rapidjson::Document& d
 
     card c;
     for (auto j = begin(json_foundations.GetArray()); j != end(json_foundations.GetArray()); j++) {
-        assert(j->IsString());
-        c = card(j->GetString());
-        gs.place_card(gs.foundations[c.get_suit()], c);
+        c = parse_card(gs, *j);
+        place_card(gs, gs.foundations[c.get_suit()], c);
     }
 
     // If the game uses a random base for foundations, assume that the first card in the first foundation is that base
     if (!gs.rules.foundations_base) {
         auto& first_found = gs.piles[gs.foundations[c.get_suit()]];
-        gs.foundations_base = first_found[first_found.size() - 1].get_rank();
+        gs.set_foundations_base(first_found[first_found.size() - 1].get_rank());
     }
 
     return true;
@@ -304,6 +301,40 @@ void deal_parser::fill_foundations(game_state &gs) {
     assert(gs.foundations.size() == foundations_count);
 
     for (uint8_t f_idx = 0; f_idx < foundations_count; f_idx++) {
-        gs.place_card(gs.foundations[f_idx], card(f_idx % uint8_t(4), 1));
+        place_card(gs, gs.foundations[f_idx], card(f_idx % uint8_t(4), 1));
+    }
+}
+
+// Reads a card, rejecting any string that isn't one, and any rank the game
+// doesn't have, as the card would index past the tables kept for each card
+card deal_parser::parse_card(const game_state& gs, const Value& json_card, bool face_down_possible) {
+    if (!json_card.IsString()) json_helper::json_parse_err("Cards must be strings");
+    const string str = json_card.GetString();
+
+    static const string suits = "cdhsCDHS";
+    static const string face_ranks = "aAjJqQkK";
+    bool valid = str.size() >= 2 && str.size() <= 3 && suits.find(str.back()) != string::npos;
+    if (valid) {
+        const string rank_str = str.substr(0, str.size() - 1);
+        bool face = rank_str.size() == 1 && face_ranks.find(rank_str[0]) != string::npos;
+        bool number = std::all_of(begin(rank_str), end(rank_str), ::isdigit)
+                      && rank_str[0] != '0' && stoi(rank_str) <= 13;
+        valid = face || number;
+    }
+    if (!valid) json_helper::json_parse_err("Unknown card '" + str + "'");
+
+    card c(str.c_str(), face_down_possible);
+    if (c.get_rank() > gs.rules.max_rank) {
+        json_helper::json_parse_err("Card '" + str + "' is above the game's highest rank");
+    }
+    return c;
+}
+
+// Piles hold their cards inline, so a deal with a pile longer than any game
+// could need is rejected before it is placed
+void deal_parser::place_card(game_state& gs, uint8_t pr, card c) {
+    if (gs.piles[pr].size() == pile::capacity) {
+        json_helper::json_parse_err("A pile holds more than " + to_string(pile::capacity) + " cards");
     }
+    gs.place_card(pr, c);
 }
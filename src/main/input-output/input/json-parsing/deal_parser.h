@@ -32,6 +32,7 @@
 #include "../../../../../lib/rapidjson/schema.h"
 
 class game_state;
+class card;
 
 class deal_parser {
 public:
@@ -47,6 +48,10 @@ public:
     static bool parse_foundations(game_state&, const rapidjson::Document&);
     static void fill_foundations(game_state&);
     static std::string deal_schema_json();
+
+private:
+    static card parse_card(const game_state&, const rapidjson::Value&, bool = false);
+    static void place_card(game_state&, uint8_t, card);
 };
 
 #endif //SOLVITAIRE_DEAL_PARSER_H
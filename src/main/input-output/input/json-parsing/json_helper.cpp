@@ -98,6 +98,14 @@ void json_helper::print_game_state_as_json(const game_state& gs) {
     write_json (cout, pt);
 }
 
+ptree json_helper::piles_to_ptree(const game_state& gs, const ordered_piles& piles) {
+    ptree pt;
+    for (pile::ref pr : piles) {
+        pt.push_back(make_pair("", pile_to_ptree(gs.piles[pr])));
+    }
+    return pt;
+}
+
 ptree json_helper::piles_to_ptree(const game_state& gs, const std::list<pile::ref>& piles) {
     ptree pt;
     for (pile::ref pr : piles) {
@@ -70,6 +70,19 @@ const sol_rules rules_parser::from_preset(const string sol_type) {
     return sr;
 }
 
+const sol_rules rules_parser::from_json(const string& rules_json) {
+    sol_rules sr = get_default();
+
+    Document d;
+    d.Parse(rules_json.c_str());
+    if (d.HasParseError()) {
+        json_helper::json_parse_err("rules not valid json");
+    }
+
+    modify_sol_rules(sr, d);
+    return sr;
+}
+
 sol_rules rules_parser::get_default() {
     sol_rules sr;
     const string default_json = sol_preset_types::get("default");
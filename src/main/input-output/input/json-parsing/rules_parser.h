@@ -30,6 +30,7 @@ class rules_parser {
 public:
     static const sol_rules from_file(std::string);
     static const sol_rules from_preset(std::string);
+    static const sol_rules from_json(const std::string&);
     static std::string rules_schema_json();
 
 private:
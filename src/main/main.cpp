@@ -17,6 +17,9 @@
   with this program (see LICENSE file); if not, write to the Free Software
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
+#include <signal.h>
+#include <atomic>
+
 #include <boost/program_options.hpp>
 #include <boost/optional.hpp>
 
@@ -28,8 +31,10 @@
 #include "input-output/input/json-parsing/rules_parser.h"
 #include "input-output/output/log_helper.h"
 #include "solver/solver.h"
+#include "solver/portfolio.h"
 #include "evaluation/solvability_calc.h"
 #include "evaluation/benchmark.h"
+#include "server/solver_server.h"
 
 using namespace rapidjson;
 
@@ -44,13 +49,23 @@ const optional<sol_rules> gen_rules(command_line_helper&);
 void solve_random_game(int, const sol_rules&, command_line_helper&);
 void solve_input_files(vector<string>, const sol_rules&, command_line_helper&);
 void solve_game(const sol_rules& rules, command_line_helper& clh, optional<int> seed, optional<const Document&> in_doc);
-pair<solver, solver::result> solve_game(const sol_rules& rules, uint64_t timeout, uint64_t cache_capacity,
-                                        game_state::streamliner_options str_opts,
-                                        optional<int> seed, optional<const Document&> in_doc);
 void print_version();
 
+// The server being run, if any, which an interrupt shuts down
+static std::atomic<solver_server*> running_server(nullptr);
+
+// Stops every search, so that what has been found so far is still printed.
+// A server answers the requests in flight with what they found, then stops
+static void sigint_handler(int) {
+    search_budget::interrupt_all();
+    solver_server* server = running_server;
+    if (server) server->stop();
+}
+
 // Decides what to do given supplied command-line options
 int main(int argc, const char* argv[]) {
+    // Set interrupt handler
+    signal(SIGINT, sigint_handler);
 
     // Parses the command-line options
     command_line_helper clh;
@@ -76,6 +91,38 @@ int main(int argc, const char* argv[]) {
         return EXIT_SUCCESS;
     }
 
+    // If the user has asked to serve requests, does so. Those that don't give
+    // a game type are solved with the one on the command line, if any
+    const string serve = clh.get_serve();
+    if (!serve.empty()) {
+        optional<sol_rules> rules;
+        if (!clh.get_solitaire_type().empty() || !clh.get_rules_file().empty()) {
+            rules = gen_rules(clh);
+            if (!rules) return EXIT_FAILURE;
+        }
+
+        solver_server server(rules, clh.get_cache_options(), clh.get_threads_per_deal(), clh.get_timeout(),
+                             clh.get_streamliners());
+        running_server = &server;
+
+        // Without SA_RESTART, so that an interrupt also ends a read from
+        // stdin that is waiting on the next request
+        struct sigaction sa{};
+        sa.sa_handler = sigint_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;
+        sigaction(SIGINT, &sa, nullptr);
+
+        bool served = true;
+        if (serve == "-") {
+            server.serve(cin, cout);
+        } else {
+            served = server.serve_socket(serve, clh.get_cores());
+        }
+        running_server = nullptr;
+        return served ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Generates the rules of the solitaire from the game type
     const optional<sol_rules> rules = gen_rules(clh);
     if (!rules) return EXIT_FAILURE;
@@ -88,7 +135,7 @@ int main(int argc, const char* argv[]) {
 
     // If the user has asked for a solvability percentage, calculates it
     if (clh.get_solvability() > 0) {
-        solvability_calc solv_c(*rules, clh.get_cache_capacity());
+        solvability_calc solv_c(*rules, clh.get_cache_options(), clh.get_threads_per_deal());
         solv_c.calculate_solvability_percentage(clh.get_timeout(), clh.get_solvability(), clh.get_cores(),
                                                 clh.get_streamliners(), clh.get_resume());
     }
@@ -98,7 +145,7 @@ int main(int argc, const char* argv[]) {
     }
     // If the benchmark option has been supplied, generates it
     else if (clh.get_benchmark()) {
-        benchmark::run(*rules, clh.get_cache_capacity(), clh.get_streamliners_game_state());
+        benchmark::run(*rules, clh.get_cache_options(), clh.get_streamliners_game_state());
     }
     // Otherwise there are supplied input files which should be solved
     else {
@@ -157,62 +204,35 @@ void solve_input_files(const vector<string> input_files, const sol_rules& rules,
 }
 
 void solve_game(const sol_rules& rules, command_line_helper& clh, optional<int> seed, optional<const Document&> in_doc) {
-    typedef pair<solver, solver::result> solve_sol;
+    const bool smart = clh.get_streamliners() == command_line_helper::streamliner_opt::SMART;
+    const millisec timeout(clh.get_timeout());
 
-    bool smart = clh.get_streamliners() == command_line_helper::streamliner_opt::SMART;
+    const portfolio p(portfolio::for_streamliners(clh.get_streamliners(), timeout),
+                      clh.get_cache_options(), clh.get_threads_per_deal());
 
-    uint64_t timeout;
-    game_state::streamliner_options str_opt;
-    if (smart) {
-        timeout = clh.get_timeout() / 10;
-        str_opt = game_state::streamliner_options::BOTH;
-    } else {
-        timeout = clh.get_timeout();
-        str_opt = clh.get_streamliners_game_state();
-    }
-    solve_sol solution = solve_game(rules, timeout, clh.get_cache_capacity(), str_opt, seed, in_doc);
+    search_budget budget(timeout);
+    const portfolio::outcome out = p.run([&](game_state::streamliner_options str_opts) {
+        return seed ? game_state(rules, *seed, str_opts) : game_state(rules, *in_doc, str_opts);
+    }, budget);
+    const portfolio::attempt& answer = out.answer();
 
-    bool run_again = smart && solution.second.sol_type != solver::result::type::SOLVED;
     cout.flush();
-    if (run_again)
-        if (!clh.get_classify()) cout << "Unsolvable using streamliner. Running again...\n";
-    optional<solve_sol> streamliner_solution = run_again
-            ? solve_game(rules, clh.get_timeout(), clh.get_cache_capacity(), game_state::streamliner_options::NONE, seed, in_doc)
-            : optional<solve_sol>();
-
     if (clh.get_classify()) {
         if (seed) cout << *seed;
-        solver::print_result_csv(solution.second);
         if (smart) {
-            if (run_again) {
-                solver::print_result_csv(streamliner_solution->second);
-                cout << ", " << streamliner_solution->second.sol_type;
-            } else {
-                solver::print_null_seed_info();
-                cout << ", " << solution.second.sol_type;
-            }
+            for (const portfolio::attempt& a : out.attempts) solver::print_result_csv(a.res);
         } else {
-            cout << ", " << solution.second.sol_type;
+            solver::print_result_csv(answer.res);
         }
+        cout << ", " << answer.res.sol_type;
         cout << "\n";
     } else {
-        pair<solver, solver::result> s = run_again ? *streamliner_solution : solution;
-
-        if (s.second.sol_type == solver::result::type::SOLVED) {
-            s.first.print_solution();
+        if (answer.res.sol_type == solver::result::type::SOLVED) {
+            solver::print_solution(answer.init_state, answer.solution);
         } else {
-            cout << "Deal:\n" << s.first.init_state << "\n";
+            cout << "Deal:\n" << answer.init_state << "\n";
         }
-        cout << s.second;
+        cout << answer.res;
     }
     cout.flush();
 }
-
-pair<solver, solver::result> solve_game(const sol_rules& rules, uint64_t timeout, uint64_t cache_capacity,
-                                        game_state::streamliner_options str_opts,
-                                        optional<int> seed, optional<const Document&> in_doc) {
-    game_state gs = seed ? game_state(rules, *seed, str_opts) : game_state(rules, *in_doc, str_opts);
-    solver sol(gs, cache_capacity);
-    solver::result res = sol.run(std::chrono::milliseconds(timeout));
-    return make_pair(sol, res);
-}
@@ -0,0 +1,317 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "solver_server.h"
+#include "../input-output/input/sol_preset_types.h"
+#include "../input-output/input/json-parsing/rules_parser.h"
+#include "../input-output/output/log_helper.h"
+
+using namespace std;
+using namespace rapidjson;
+
+using boost::optional;
+
+typedef command_line_helper::streamliner_opt cmd_sos;
+typedef game_state::streamliner_options sos;
+typedef chrono::milliseconds millisec;
+
+solver_server::solver_server(const optional<sol_rules>& rules, const cache_options& cache_opts_,
+                             uint threads_per_deal_, uint64_t timeout, cmd_sos streamliners)
+        : default_rules(rules)
+        , cache_opts(cache_opts_)
+        , threads_per_deal(threads_per_deal_)
+        , default_timeout(timeout)
+        , default_streamliners(streamliners)
+        , stopped(false) {
+    if (pipe(stop_pipe) < 0) throw runtime_error(string("could not create a pipe: ") + strerror(errno));
+}
+
+solver_server::~solver_server() {
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+}
+
+void solver_server::stop() {
+    stopped = true;
+    // The pipe is never read from, so stays readable from now on
+    ssize_t written = write(stop_pipe[1], "x", 1);
+    (void) written;
+}
+
+/////////////
+// SERVING //
+/////////////
+
+// A read from the terminal that is waiting when the server is stopped only
+// gives up if the signal that stopped it interrupts the read
+void solver_server::serve(istream& in, ostream& out) {
+    for (string line; !stopped && getline(in, line); ) {
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+        out << respond(line) << "\n";
+        out.flush();
+    }
+}
+
+bool solver_server::serve_socket(const string& path, uint cores) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Error: socket path is too long: " << path);
+        return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // Replaces the socket of a server that has since stopped, but nothing else
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            LOG_ERROR("Error: " << path << " exists and is not a socket");
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    // Every thread waits on the listener, and those that lose the race for a
+    // connection mustn't block in accept, where being stopped can't reach them
+    if (listener < 0
+        || fcntl(listener, F_SETFL, O_NONBLOCK) < 0
+        || ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        LOG_ERROR("Error: could not listen on " << path << ": " << strerror(errno));
+        if (listener >= 0) close(listener);
+        return false;
+    }
+    LOG_INFO("Listening on " << path << "...");
+
+    // Each thread accepts connections of its own, so that a long search only
+    // holds up the requests on its own connection
+    vector<thread> threads;
+    for (uint c = 1; c < cores; c++)
+        threads.emplace_back(&solver_server::serve_connections, this, listener);
+    serve_connections(listener);
+
+    for (auto& t : threads) t.join();
+    close(listener);
+    unlink(path.c_str());
+    LOG_INFO("Stopped listening on " << path);
+    return true;
+}
+
+void solver_server::serve_connections(int listener) {
+    while (wait_to_read(listener)) {
+        int conn = accept(listener, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            LOG_ERROR("Error: could not accept a connection: " << strerror(errno));
+            return;
+        }
+        serve_connection(conn);
+        close(conn);
+    }
+}
+
+// Answers the requests on a connection until the client closes it
+void solver_server::serve_connection(int conn) {
+    string buf;
+    char chunk[4096];
+    ssize_t n;
+    while (wait_to_read(conn) && (n = read(conn, chunk, sizeof(chunk))) > 0) {
+        buf.append(chunk, static_cast<size_t>(n));
+
+        string::size_type end;
+        while ((end = buf.find('\n')) != string::npos) {
+            string line = buf.substr(0, end);
+            buf.erase(0, end + 1);
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+            string res = respond(line) + "\n";
+            for (string::size_type sent = 0; sent < res.size(); ) {
+                // Doesn't raise SIGPIPE if the client has gone
+                ssize_t s = send(conn, res.data() + sent, res.size() - sent, MSG_NOSIGNAL);
+                if (s < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                sent += static_cast<string::size_type>(s);
+            }
+        }
+    }
+}
+
+// Waits until the descriptor can be read from. Returns false if the server is
+// stopped first
+bool solver_server::wait_to_read(int fd) const {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+    while (!stopped) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (fds[1].revents != 0) return false;
+        if (fds[0].revents != 0) return true;
+    }
+    return false;
+}
+
+//////////////
+// REQUESTS //
+//////////////
+
+// Requests are answered with the id they give, if any, and either the result
+// or an error
+string solver_server::respond(const string& line) {
+    StringBuffer sb;
+    json_writer w(sb);
+    w.StartObject();
+
+    Document d;
+    d.Parse(line.c_str());
+    if (d.HasParseError() || !d.IsObject()) {
+        w.Key("error");
+        w.String("request is not a JSON object");
+        w.EndObject();
+        return sb.GetString();
+    }
+
+    if (d.HasMember("id")) {
+        w.Key("id");
+        d["id"].Accept(w);
+    }
+
+    try {
+        request req = parse_request(d);
+        if (req.seed) {
+            w.Key("seed");
+            w.Int(*req.seed);
+        }
+
+        // With smart streamliners, the answer may come from either search.
+        // If it is the unstreamlined one, the streamliner's result follows it
+        const portfolio::outcome out = solve(req);
+        write_result(w, out.answer().res);
+        if (req.streamliners == cmd_sos::SMART && out.chosen != 0) {
+            w.Key("streamliner result");
+            w.StartObject();
+            write_result(w, out.attempts[0].res);
+            w.EndObject();
+        }
+    } catch (const exception& error) {
+        w.Key("error");
+        w.String(error.what());
+    }
+
+    w.EndObject();
+    return sb.GetString();
+}
+
+solver_server::request solver_server::parse_request(const Document& d) {
+    request req;
+
+    if (d.HasMember("type")) {
+        if (!d["type"].IsString()) throw runtime_error("[type] must be a string");
+        req.rules = &preset_rules(d["type"].GetString());
+    } else if (default_rules) {
+        req.rules = &*default_rules;
+    } else {
+        throw runtime_error("request must give a [type], as the server was started without one");
+    }
+
+    if (d.HasMember("seed") == d.HasMember("deal"))
+        throw runtime_error("request must give one of [seed] and [deal]");
+    if (d.HasMember("seed")) {
+        if (!d["seed"].IsInt()) throw runtime_error("[seed] must be an integer");
+        req.seed = d["seed"].GetInt();
+    } else {
+        if (!d["deal"].IsObject()) throw runtime_error("[deal] must be an object");
+        req.deal.reset(new Document);
+        req.deal->CopyFrom(d["deal"], req.deal->GetAllocator());
+    }
+
+    req.timeout = millisec(default_timeout);
+    if (d.HasMember("timeout")) {
+        if (!d["timeout"].IsUint64()) throw runtime_error("[timeout] must be a non-negative integer");
+        req.timeout = millisec(d["timeout"].GetUint64());
+    }
+
+    req.streamliners = default_streamliners;
+    if (d.HasMember("streamliners")) {
+        optional<cmd_sos> s;
+        if (d["streamliners"].IsString()) s = command_line_helper::parse_streamliners(d["streamliners"].GetString());
+        if (!s) throw runtime_error("[streamliners] must be one of the '--streamliners' options");
+        req.streamliners = *s;
+    }
+
+    return req;
+}
+
+const sol_rules& solver_server::preset_rules(const string& type) {
+    lock_guard<mutex> lock(presets_mutex);
+
+    auto iter = presets.find(type);
+    if (iter != end(presets)) return iter->second;
+
+    if (!sol_preset_types::is_valid_preset(type))
+        throw runtime_error("solitaire type is not valid: " + type);
+    return presets.emplace(type, rules_parser::from_preset(type)).first->second;
+}
+
+// Solves the deal, freeing the caches before returning
+portfolio::outcome solver_server::solve(const request& req) const {
+    const portfolio p(portfolio::for_streamliners(req.streamliners, req.timeout), cache_opts, threads_per_deal);
+    search_budget budget(req.timeout);
+    return p.run([&](sos str_opts) {
+        return req.seed ? game_state(*req.rules, *req.seed, str_opts) : game_state(*req.rules, *req.deal, str_opts);
+    }, budget);
+}
+
+// Writes the fields of the classify output
+void solver_server::write_result(json_writer& w, const solver::result& res) {
+    stringstream outcome;
+    outcome << res.sol_type;
+
+    w.Key("outcome");                    w.String(outcome.str().c_str());
+    w.Key("time taken");                 w.Int64(res.time.count());
+    w.Key("teardown time");              w.Int64(res.teardown_time.count());
+    w.Key("states searched");            w.Uint64(res.states_searched);
+    w.Key("unique states searched");     w.Uint64(res.unique_states_searched);
+    w.Key("backtracks");                 w.Uint64(res.backtracks);
+    w.Key("dominance moves");            w.Uint64(res.dominance_moves);
+    w.Key("states removed from cache");  w.Uint64(res.states_removed_from_cache);
+    w.Key("final states in cache");      w.Uint64(res.cache_size);
+    w.Key("final buckets in cache");     w.Uint64(res.cache_bucket_count);
+    w.Key("final cache bytes");          w.Uint64(res.cache_bytes);
+    w.Key("peak cache bytes");           w.Uint64(res.peak_cache_bytes);
+    w.Key("maximum search depth");       w.Uint64(res.max_depth);
+    w.Key("final search depth");         w.Uint64(res.depth);
+}
@@ -0,0 +1,107 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_SOLVER_SERVER_H
+#define SOLVITAIRE_SOLVER_SERVER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <iostream>
+
+#include <boost/optional.hpp>
+
+#include "../../../lib/rapidjson/document.h"
+#include "../../../lib/rapidjson/writer.h"
+#include "../../../lib/rapidjson/stringbuffer.h"
+#include "../game/sol_rules.h"
+#include "../game/global_cache.h"
+#include "../solver/solver.h"
+#include "../solver/portfolio.h"
+#include "../input-output/input/command_line_helper.h"
+
+// Solves deals on request, so that many can be solved by one process rather
+// than starting one per deal. Each request is a JSON object on a line of its
+// own, and is answered by one line holding a JSON object with the same fields
+// as the classify output. Preset rules are parsed once, on first use
+class solver_server {
+public:
+    // Requests that don't name a game type are solved with the given rules,
+    // and those that don't give a timeout or streamliners with the given ones
+    solver_server(const boost::optional<sol_rules>&, const cache_options&, uint, uint64_t,
+                  command_line_helper::streamliner_opt);
+    ~solver_server();
+    solver_server(const solver_server&) = delete;
+    solver_server& operator=(const solver_server&) = delete;
+
+    // Answers the requests read from the stream, until it ends or the server
+    // is stopped
+    void serve(std::istream&, std::ostream&);
+    // Answers the requests on each connection to a Unix socket at the path,
+    // serving the given number of connections at once, until the server is
+    // stopped. Returns false if the socket can't be listened on
+    bool serve_socket(const std::string&, uint);
+
+    // Stops serving once the requests in flight have been answered. The
+    // searches aren't cancelled, so the caller should cancel them too if they
+    // are not to run to the end. Safe to call from a signal handler
+    void stop();
+
+    // The answer to a request, without its newline
+    std::string respond(const std::string&);
+
+private:
+    typedef rapidjson::Writer<rapidjson::StringBuffer> json_writer;
+
+    struct request {
+        const sol_rules* rules;
+        boost::optional<int> seed;
+        std::unique_ptr<rapidjson::Document> deal;
+        std::chrono::milliseconds timeout;
+        command_line_helper::streamliner_opt streamliners;
+    };
+
+    request parse_request(const rapidjson::Document&);
+    const sol_rules& preset_rules(const std::string&);
+    portfolio::outcome solve(const request&) const;
+    void serve_connections(int);
+    void serve_connection(int);
+    bool wait_to_read(int) const;
+    static void write_result(json_writer&, const solver::result&);
+
+    const boost::optional<sol_rules> default_rules;
+    const cache_options cache_opts;
+    const uint threads_per_deal;
+    const uint64_t default_timeout;
+    const command_line_helper::streamliner_opt default_streamliners;
+
+    // Never erased from, so references into it stay valid
+    std::map<std::string, sol_rules> presets;
+    std::mutex presets_mutex;
+
+    // Written to when the server is stopped, so that it can wait on a
+    // socket and on being stopped at once
+    std::atomic<bool> stopped;
+    int stop_pipe[2];
+};
+
+#endif //SOLVITAIRE_SOLVER_SERVER_H
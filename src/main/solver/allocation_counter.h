@@ -0,0 +1,31 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_ALLOCATION_COUNTER_H
+#define SOLVITAIRE_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+// The number of times operator new has been called on the calling thread, so
+// that the solver can report how many heap allocations each node costs. The
+// library build doesn't count them, and always gives zero
+uint64_t thread_allocation_count();
+
+#endif //SOLVITAIRE_ALLOCATION_COUNTER_H
@@ -0,0 +1,238 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "portfolio.h"
+
+using std::vector;
+using boost::optional;
+
+typedef game_state::streamliner_options sos;
+typedef std::chrono::milliseconds millisec;
+
+portfolio::portfolio(vector<config> configs_, const cache_options& cache_opts_, uint threads, uint helpers)
+        : configs(std::move(configs_))
+        , cache_opts(share_of(cache_opts_, configs.size()))
+        , threads_per_config(threads)
+        , max_helpers(helpers)
+        , joins_searches(helpers > 0 && solver::can_take_help(cache_opts_, threads))
+        , alternatives(helpers > 0 && !joins_searches ? alternatives_to(configs) : vector<config>())
+        , running_mutex()
+        , running_changed()
+        , current_run(nullptr)
+        , running(configs.size(), running_search{nullptr, 0}) {
+    assert(!configs.empty());
+}
+
+portfolio::run_state::run_state(const dealer& deal_, search_budget& budget_)
+        : deal(deal_)
+        , budget(budget_)
+        , out()
+        , budgets()
+        , decision_mutex()
+        , decider()
+        , searches_started(0)
+        , racing_helpers(0) {
+}
+
+const portfolio::attempt& portfolio::outcome::answer() const {
+    return chosen < attempts.size() ? attempts[chosen] : alternatives[chosen - attempts.size()];
+}
+
+vector<portfolio::config> portfolio::for_streamliners(command_line_helper::streamliner_opt str_opt, millisec timeout) {
+    if (str_opt == command_line_helper::streamliner_opt::SMART) {
+        return {config{sos::BOTH, timeout / 10}, config{sos::NONE, boost::none}};
+    } else {
+        return {config{command_line_helper::convert_streamliners(str_opt), boost::none}};
+    }
+}
+
+// The searches run at once, so each caches within its share of the states and
+// memory the options allow
+cache_options portfolio::share_of(const cache_options& opts, std::size_t searches) {
+    cache_options res(opts);
+    if (searches <= 1) return res;
+    res.capacity = std::max<uint64_t>(opts.capacity / searches, 1);
+    if (opts.memory > 0) res.memory = std::max<uint64_t>(opts.memory / searches, 1);
+    return res;
+}
+
+uint portfolio::threads_per_deal(command_line_helper::streamliner_opt str_opt, uint threads) {
+    return uint(for_streamliners(str_opt, millisec(0)).size()) * threads;
+}
+
+bool portfolio::is_sound(const config& c) {
+    return c.streamliners == sos::NONE;
+}
+
+// The streamliner options none of the configs use, streamlined ones first as
+// they tend to find solutions soonest
+vector<portfolio::config> portfolio::alternatives_to(const vector<config>& configs) {
+    vector<config> res;
+    for (sos s : {sos::BOTH, sos::AUTO_FOUNDATIONS, sos::SUIT_SYMMETRY, sos::NONE}) {
+        const bool used = std::any_of(begin(configs), end(configs), [s](const config& c) { return c.streamliners == s; });
+        if (!used) res.push_back(config{s, boost::none});
+    }
+    return res;
+}
+
+// The searches of a run are numbered with the configs first, then the
+// alternatives
+const portfolio::config& portfolio::config_of(std::size_t i) const {
+    return i < configs.size() ? configs[i] : alternatives[i - configs.size()];
+}
+
+portfolio::attempt& portfolio::attempt_of(run_state& st, std::size_t i) const {
+    return i < configs.size() ? st.out.attempts[i] : st.out.alternatives[i - configs.size()];
+}
+
+portfolio::outcome portfolio::run(const dealer& deal, search_budget& budget,
+                                  const std::function<void()>& on_start) const {
+    run_state st(deal, budget);
+    for (const config& c : configs) {
+        st.out.attempts.push_back(attempt{deal(c.streamliners), solver::result(), vector<move>()});
+        st.budgets.emplace_back(new search_budget(c.timeout, &budget));
+    }
+    // The alternatives are dealt as helpers start them, into space reserved
+    // up front so that the attempts already started don't move
+    st.out.alternatives.reserve(alternatives.size());
+    for (const config& c : alternatives) st.budgets.emplace_back(new search_budget(c.timeout, &budget));
+
+    if (max_helpers > 0) {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        current_run = &st;
+    }
+    if (on_start) on_start();
+
+    vector<std::thread> threads;
+    for (std::size_t i = 1; i < configs.size(); i++) threads.emplace_back([this, &st, i] { race(st, i); });
+    race(st, 0);
+    for (auto& t : threads) t.join();
+
+    // No alternative is started once the searches are over, and those being
+    // raced are left to finish, as they may yet find a solution
+    if (max_helpers > 0) {
+        std::unique_lock<std::mutex> lock(running_mutex);
+        current_run = nullptr;
+        running_changed.wait(lock, [&st] { return st.racing_helpers == 0; });
+    }
+
+    outcome out = std::move(st.out);
+    if (st.decider) {
+        out.chosen = *st.decider;
+    } else {
+        auto sound = std::find_if(begin(configs), end(configs), is_sound);
+        out.chosen = sound == end(configs) ? 0 : std::size_t(sound - begin(configs));
+    }
+    return out;
+}
+
+void portfolio::race(run_state& st, std::size_t i) const {
+    attempt& a = attempt_of(st, i);
+    solver sol(a.init_state, cache_opts, threads_per_config);
+    const bool joinable = joins_searches && i < configs.size();
+    if (i < configs.size() && max_helpers > 0) {
+        if (joinable) sol.allow_helpers(max_helpers);
+        std::lock_guard<std::mutex> lock(running_mutex);
+        if (joinable) running[i].sol = &sol;
+        st.searches_started++;
+        running_changed.notify_all();
+    }
+    a.res = sol.run(*st.budgets[i]);
+    if (joinable) {
+        std::unique_lock<std::mutex> lock(running_mutex);
+        running[i].sol = nullptr;
+        running_changed.wait(lock, [this, i] { return running[i].users == 0; });
+    }
+    a.solution = sol.get_solution();
+
+    // Takes the first conclusive answer, and stops the rest before this
+    // search's cache is freed
+    {
+        std::lock_guard<std::mutex> lock(st.decision_mutex);
+        const bool conclusive = a.res.sol_type == solver::result::type::SOLVED
+                || (a.res.sol_type == solver::result::type::UNSOLVABLE && is_sound(config_of(i)));
+        if (conclusive && !st.decider) {
+            st.decider = i;
+            for (std::size_t j = 0; j < st.budgets.size(); j++) {
+                if (j != i) st.budgets[j]->cancel();
+            }
+        }
+    }
+
+    a.res.teardown_time = sol.release_cache();
+}
+
+// The search a helper should join, or the number of searches if none can be.
+// The searches believed when they find the deal unsolvable are the ones left
+// running to the end, so they are helped first
+std::size_t portfolio::helped_search() const {
+    std::size_t target = running.size();
+    for (std::size_t i = 0; i < running.size(); i++) {
+        if (!running[i].sol) continue;
+        if (target == running.size() || (is_sound(configs[i]) && !is_sound(configs[target]))) target = i;
+    }
+    return target;
+}
+
+bool portfolio::help() const {
+    std::unique_lock<std::mutex> lock(running_mutex);
+
+    // Waits for every search of the run to start, so that a helper arriving
+    // early isn't turned away
+    running_changed.wait(lock, [this] { return !current_run || current_run->searches_started == configs.size(); });
+    if (!current_run) return false;
+
+    if (!joins_searches) {
+        run_state& st = *current_run;
+        const std::size_t k = st.out.alternatives.size();
+        if (k == alternatives.size() || st.budgets[configs.size() + k]->is_cancelled()) return false;
+
+        st.out.alternatives.push_back(attempt{st.deal(alternatives[k].streamliners), solver::result(), vector<move>()});
+        st.racing_helpers++;
+        lock.unlock();
+
+        race(st, configs.size() + k);
+
+        lock.lock();
+        st.racing_helpers--;
+        running_changed.notify_all();
+        return true;
+    }
+
+    const std::size_t target = helped_search();
+    if (target == running.size()) return false;
+
+    running_search& r = running[target];
+    r.users++;
+    lock.unlock();
+
+    const bool helped = r.sol->help();
+
+    lock.lock();
+    r.users--;
+    running_changed.notify_all();
+    return helped;
+}
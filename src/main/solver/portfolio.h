@@ -0,0 +1,148 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_PORTFOLIO_H
+#define SOLVITAIRE_PORTFOLIO_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include <boost/optional.hpp>
+
+#include "solver.h"
+#include "search_budget.h"
+#include "../game/move.h"
+#include "../game/global_cache.h"
+#include "../game/search-state/game_state.h"
+#include "../input-output/input/command_line_helper.h"
+
+// Races several ways of searching one deal, each on its own thread, and takes
+// the first conclusive answer. Any search that solves the deal is believed,
+// but streamliners can prune away every solution, so only a search without
+// them is believed when it finds the deal unsolvable. Once an answer is taken
+// the other searches are cancelled
+class portfolio {
+public:
+    // One way of searching the deal, with its own timeout if it is to give up
+    // before the rest
+    struct config {
+        game_state::streamliner_options streamliners;
+        boost::optional<std::chrono::milliseconds> timeout;
+    };
+
+    // What became of one of the searches
+    struct attempt {
+        game_state init_state;
+        solver::result res;
+        std::vector<move> solution;
+    };
+
+    struct outcome {
+        std::vector<attempt> attempts; // In the order of the configs
+        // The alternative configs helpers raced, in the order they were started
+        std::vector<attempt> alternatives;
+        // The attempt whose answer is the portfolio's, counting the
+        // alternatives after the attempts. If none is conclusive, the first
+        // attempt that is believed when it finds the deal unsolvable
+        std::size_t chosen;
+
+        const attempt& answer() const;
+    };
+
+    // Deals the game with the given streamliners
+    typedef std::function<game_state(game_state::streamliner_options)> dealer;
+
+    // The searches share the cache options' capacity and memory. Each search
+    // can be joined by up to the given number of helpers. A portfolio that
+    // takes helpers runs one deal at a time. If the cache can't be shared,
+    // helpers instead race the streamliner options the configs don't use,
+    // each with a search's share of the cache. That is the cache of the seed
+    // the helper no longer has, so together they keep within the budget
+    portfolio(std::vector<config>, const cache_options&, uint = 1, uint = 0);
+
+    // The searches draw from the budget together, and stop when it is
+    // cancelled. The callback, if given, is called once helpers can join
+    outcome run(const dealer&, search_budget&, const std::function<void()>& = nullptr) const;
+    // Joins one of the searches of the run in progress on another thread, or
+    // races an alternative to them, until the run's answer is found. Returns
+    // false if there is no run in progress, or nothing left in it to help with
+    bool help() const;
+
+    // The searches to make for a streamliner option, given the timeout. Smart
+    // solvability races streamliners, with a tenth of the time, against none
+    static std::vector<config> for_streamliners(command_line_helper::streamliner_opt, std::chrono::milliseconds);
+    static bool is_sound(const config&);
+    // How many threads a deal is searched with, given the threads per search
+    static uint threads_per_deal(command_line_helper::streamliner_opt, uint);
+
+    // The cache options of each search, when the given number share them
+    static cache_options share_of(const cache_options&, std::size_t);
+
+private:
+    // The state of a run that its searches and helpers share
+    struct run_state {
+        run_state(const dealer&, search_budget&);
+
+        const dealer& deal;
+        search_budget& budget;
+        outcome out;
+        // Of the configs, then of the alternatives
+        std::vector<std::unique_ptr<search_budget>> budgets;
+        std::mutex decision_mutex;
+        boost::optional<std::size_t> decider;
+        // The searches of the configs that have started, and the alternatives
+        // helpers are racing. Guarded by the running mutex
+        std::size_t searches_started;
+        uint racing_helpers;
+    };
+
+    static std::vector<config> alternatives_to(const std::vector<config>&);
+    const config& config_of(std::size_t) const;
+    attempt& attempt_of(run_state&, std::size_t) const;
+    void race(run_state&, std::size_t) const;
+    std::size_t helped_search() const;
+
+    const std::vector<config> configs;
+    const cache_options cache_opts;
+    const uint threads_per_config;
+    const uint max_helpers;
+    // Whether helpers join the searches, which needs a cache they can share
+    const bool joins_searches;
+    // Otherwise, what the helpers race
+    const std::vector<config> alternatives;
+
+    // The run in progress, its solvers, and how many threads are joining
+    // each. A solver isn't freed until they have all left it
+    struct running_search {
+        solver* sol;
+        uint users;
+    };
+
+    mutable std::mutex running_mutex;
+    mutable std::condition_variable running_changed;
+    mutable run_state* current_run;
+    mutable std::vector<running_search> running;
+};
+
+#endif //SOLVITAIRE_PORTFOLIO_H
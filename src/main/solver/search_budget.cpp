@@ -0,0 +1,84 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "search_budget.h"
+
+using boost::optional;
+
+std::atomic<bool> search_budget::interrupted(false);
+
+search_budget::search_budget(optional<std::chrono::milliseconds> timeout, search_budget* parent_)
+        : parent(parent_)
+        , cancelled(false)
+        , deadline()
+        , state_limit()
+        , memory_limit()
+        , states_spent(0) {
+    if (timeout) deadline = clock::now() + *timeout;
+}
+
+void search_budget::set_deadline(clock::time_point t) {
+    deadline = t;
+}
+
+void search_budget::set_state_limit(uint64_t n) {
+    state_limit = n;
+}
+
+void search_budget::set_memory_limit(uint64_t bytes) {
+    memory_limit = bytes;
+}
+
+void search_budget::cancel() {
+    cancelled = true;
+}
+
+bool search_budget::is_cancelled() const {
+    return cancelled || interrupted || (parent && parent->is_cancelled());
+}
+
+search_budget::limit search_budget::spend(uint64_t states, uint64_t cache_bytes) {
+    const uint64_t spent = states_spent += states;
+
+    if (parent) {
+        limit l = parent->spend(states, cache_bytes);
+        if (l != limit::NONE) return l;
+    }
+
+    if (cancelled || interrupted) {
+        return limit::CANCELLED;
+    } else if (deadline && clock::now() >= *deadline) {
+        return limit::DEADLINE;
+    } else if (state_limit && spent >= *state_limit) {
+        return limit::STATES;
+    } else if (memory_limit && cache_bytes > *memory_limit) {
+        return limit::MEMORY;
+    } else {
+        return limit::NONE;
+    }
+}
+
+uint64_t search_budget::get_states_spent() const {
+    return states_spent;
+}
+
+void search_budget::interrupt_all() {
+    interrupted = true;
+}
@@ -0,0 +1,77 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SOLVITAIRE_SEARCH_BUDGET_H
+#define SOLVITAIRE_SEARCH_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <boost/optional.hpp>
+
+// What a search may spend before it gives up, and a way to stop it from
+// another thread. A budget may be shared by several solvers, which then draw
+// on it together and are all stopped by cancelling it. A budget with a parent
+// is also bound by the parent's limits, and is cancelled along with it.
+//
+// Solvers only look at their budget every so often, so they can run a few
+// hundred states past a limit or a cancellation
+class search_budget {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    // Which limit has been reached
+    enum class limit : uint8_t {NONE, CANCELLED, DEADLINE, STATES, MEMORY};
+
+    explicit search_budget(boost::optional<std::chrono::milliseconds> = boost::none,
+                           search_budget* = nullptr);
+    search_budget(const search_budget&) = delete;
+    search_budget& operator=(const search_budget&) = delete;
+
+    void set_deadline(clock::time_point);
+    void set_state_limit(uint64_t);
+    // Cache bytes, beyond which a search stops rather than evicting states
+    void set_memory_limit(uint64_t);
+
+    // Can be called from any thread, and stays in effect
+    void cancel();
+    bool is_cancelled() const;
+
+    // Records states searched since the last call, and returns the first
+    // limit that has been reached, if any
+    limit spend(uint64_t, uint64_t);
+    uint64_t get_states_spent() const;
+
+    // Cancels every budget at once. Safe to call from a signal handler
+    static void interrupt_all();
+
+private:
+    static std::atomic<bool> interrupted;
+
+    search_budget* const parent;
+    std::atomic<bool> cancelled;
+    boost::optional<clock::time_point> deadline;
+    boost::optional<uint64_t> state_limit;
+    boost::optional<uint64_t> memory_limit;
+    std::atomic<uint64_t> states_spent;
+};
+
+#endif //SOLVITAIRE_SEARCH_BUDGET_H
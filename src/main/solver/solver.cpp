@@ -29,9 +29,12 @@
 #include <malloc.h>
 #include <chrono>
 #include <iomanip>
-#include <signal.h>
+#include <thread>
+#include <mutex>
+#include <memory>
 
 #include "solver.h"
+#include "allocation_counter.h"
 #include "../game/move.h"
 #include "../input-output/output/log_helper.h"
 #include "../input-output/output/state_printer.h"
@@ -49,20 +52,95 @@ using boost::optional;
 using std::fixed;
 using std::setprecision;
 
-static bool sigint = false;
+solver::solver(const game_state& gs, uint64_t cache_capacity)
+        : solver(gs, cache_options(cache_capacity)) {
+}
 
-void sigint_handler(int i) {
-    // So it doesn't complain about unused param
-    sigint = i == 1 ? true : true;
+// The solvers searching one deal on several threads. A solver only counts as
+// busy while its frontier holds unexplored moves, and a thief takes a move
+// from a busy solver before it lets go of that solver's lock, so once no
+// solver is busy there is no work left anywhere. Helpers may join while the
+// search is under way, into slots set aside for them, so that the solvers
+// already counted never move
+struct solver::search_group {
+    search_group(uint, search_budget&);
+    void join(std::unique_ptr<solver>, bool);
+    void finish(result::type, uint);
+
+    std::vector<std::unique_ptr<solver>> workers;
+    std::vector<std::mutex> locks; // Guards each solver's frontier
+    std::atomic<uint> worker_count;
+    std::atomic<uint> busy;
+    std::atomic<bool> stop;
+    search_budget& budget;
+    uint helpers; // Those still searching. Guarded by the helped solver's help_mutex
+
+    std::mutex outcome_mutex;
+    optional<result::type> outcome; // How the first solver to stop the search stopped
+    uint winner;
+};
+
+solver::search_group::search_group(uint capacity, search_budget& budget_)
+        : workers(capacity), locks(capacity), worker_count(0), busy(1), stop(false), budget(budget_), helpers(0)
+        , outcome_mutex(), outcome(), winner(0) {
 }
 
-solver::solver(const game_state& gs, uint64_t cache_capacity)
-        : cache(lru_cache(gs, cache_capacity))
+// Takes the next slot. Only one solver may join at a time
+void solver::search_group::join(std::unique_ptr<solver> w, bool shared) {
+    const uint id = worker_count;
+    assert(id < workers.size());
+    w->group = this;
+    w->worker_id = id;
+    w->shared_frontier = shared;
+    workers[id] = std::move(w);
+    worker_count = id + 1;
+}
+
+void solver::search_group::finish(result::type t, uint worker) {
+    std::lock_guard<std::mutex> lock(outcome_mutex);
+    if (!outcome) {
+        outcome = t;
+        winner = worker;
+    }
+    stop = true;
+}
+
+// Only the shared transposition table can be searched by several threads
+static cache_options cache_options_for(const cache_options& opts, uint threads) {
+    cache_options res(opts);
+    if (threads > 1) res.type = state_cache::backend::SHARED_TRANSPOSITION_TABLE;
+    return res;
+}
+
+solver::solver(const game_state& gs, const cache_options& cache_opts, uint threads)
+        : solver(gs, make_state_cache(gs, cache_options_for(cache_opts, threads))) {
+    threads_per_deal = std::max(threads, 1u);
+    shared_cache = can_take_help(cache_opts, threads);
+}
+
+solver::solver(const game_state& gs, std::shared_ptr<state_cache> cache_)
+        : cache(std::move(cache_))
         , init_state(gs)
         , state(gs)
         , frontier()
+        , move_stack()
         , root(move(move::mtype::null))
-        , current_node() {
+        , current_node()
+        , threads_per_deal(1)
+        , group(nullptr)
+        , worker_id(0)
+        , base_path()
+        , states_spent(0)
+        , shared_frontier(false)
+        , shared_cache(false)
+        , max_helpers(0)
+        , help_mutex()
+        , helper_left()
+        , helped(nullptr) {
+    // Leaves room for deep searches, so that the frontier and the move stack
+    // rarely have to grow once the search has started
+    frontier.reserve(1024);
+    move_stack.reserve(16384);
     frontier.push_back(root);
     current_node = begin(frontier);
     res.states_searched = 0;
@@ -72,37 +150,80 @@ solver::solver(const game_state& gs, uint64_t cache_capacity)
     res.states_removed_from_cache = 0;
     res.max_depth = 0;
     res.depth = 0;
+    res.allocations = 0;
+    res.moves_generated = 0;
+    res.teardown_time = millisec(0);
+}
+
+solver::node::node(const move m, uint32_t moves_pos) noexcept
+        : mv(m), cache_state(), states_searched_before(0), moves_begin(moves_pos), moves_end(moves_pos)
+        , next_stage(game_state::move_stage::NONE) {
 }
 
-solver::node::node(const move m) noexcept
-        : mv(m), child_moves(), cache_state() {
+bool solver::node::has_child_moves() const {
+    return moves_begin != moves_end;
 }
 
 solver::result solver::run(boost::optional<millisec> timeout) {
-    // Set interrupt handler
-    signal(SIGINT, sigint_handler);
+    search_budget budget(timeout);
+    return run(budget);
+}
 
-    // Set timings
+solver::result solver::run(search_budget& budget) {
     const clock::time_point start_time = clock::now();
-    result::type res_type = timeout ? dfs(start_time + *timeout) : dfs();
-    res.sol_type = res_type;
-    res.states_removed_from_cache = cache.get_states_removed_from_cache();
-    res.cache_size = cache.size();
-    res.cache_bucket_count = cache.bucket_count();
+
+    res.sol_type = threads_per_deal > 1 || max_helpers > 0 ? run_parallel(budget) : dfs(budget);
+    res.states_removed_from_cache = cache->get_states_removed_from_cache();
+    res.cache_size = cache->size();
+    res.cache_bucket_count = cache->bucket_count();
+    res.cache_bytes = cache->bytes_used();
+    res.peak_cache_bytes = cache->peak_bytes_used();
+    res.cache_bytes_per_state = res.cache_size == 0 ? 0.0
+            : double(res.cache_bytes) / double(res.cache_size);
+    state_cache::eviction_stats evictions = cache->get_eviction_stats();
+    res.mean_eviction_scan = evictions.scans == 0 ? 0.0
+            : double(evictions.total_scan_length) / double(evictions.scans);
+    res.max_eviction_scan = evictions.max_scan_length;
+    res.dead_states = cache->get_dead_state_count();
+    res.dead_state_hits = cache->get_dead_state_hits();
+    res.allocations_per_node = res.states_searched == 0 ? 0.0
+            : double(res.allocations) / double(res.states_searched);
+    res.moves_generated_per_state = res.unique_states_searched == 0 ? 0.0
+            : double(res.moves_generated) / double(res.unique_states_searched);
     res.time = std::chrono::duration_cast<millisec>(clock::now() - start_time);
     return res;
 }
 
-solver::result::type solver::dfs(boost::optional<clock::time_point> end_time) {
+// Reading the clock for every state is measurable, so the budget is only
+// looked at every so often
+const uint32_t solver::poll_interval = 256;
+
+solver::result::type solver::dfs(search_budget& budget) {
+    const uint64_t allocations_before = thread_allocation_count();
+    result::type t = search(budget);
+    res.allocations += thread_allocation_count() - allocations_before;
+
+    // Draws the states searched since the last look from the budget
+    poll(budget);
+    return t;
+}
+
+solver::result::type solver::search(search_budget& budget) {
     bool states_exhausted = false;
+    // Looks at the budget before the first state, so that a search whose
+    // budget has already run out doesn't start
+    uint32_t polls_left = 1;
 
     while(!(state.is_solved() || states_exhausted)) {
-        if (end_time && clock::now() >= *end_time) {
-            return result::type::TIMEOUT;
-        } else if (sigint) {
-            return result::type::TERMINATED;
+        if (--polls_left == 0) {
+            polls_left = poll_interval;
+            optional<result::type> stop = poll(budget);
+            if (stop) return *stop;
         }
 
+        // Other solvers may steal from the frontier while it is being changed
+        std::unique_lock<std::mutex> frontier_lock = lock_frontier();
+
 #ifndef NDEBUG
         if (current_node->mv.dominance_move) {
             LOG_DEBUG("(dominance move)");
@@ -115,23 +236,23 @@ solver::result::type solver::dfs(boost::optional<clock::time_point> end_time) {
         optional<move> dominance_move = state.get_dominance_move();
         if (dominance_move) {
             // Adds the dominance move as a child of the current search node;
-            current_node->child_moves.emplace_back(*dominance_move);
+            move_stack.push_back(*dominance_move);
+            current_node->moves_end++;
         } else {
             try {
                 // Caches the current state
-                pair<lru_cache::item_list::iterator, bool> insert_res = cache.insert(state);
+                pair<state_cache::handle, bool> insert_res = cache->insert(state);
                 current_node->cache_state = insert_res.first;
                 bool is_new_state = insert_res.second;
 
                 if (is_new_state) {
-                    // Gets the legal moves in the current state
-                    vector<move> next_moves = state.get_legal_moves(current_node->mv);
+                    // Pushes the first stage of legal moves in the current
+                    // state onto the move stack
+                    current_node->next_stage = game_state::move_stage::FOUNDATION;
 
                     // If there are none, reverts to the last node with children
-                    if (next_moves.empty()) {
+                    if (!generate_child_moves()) {
                         states_exhausted = revert_to_last_node_with_children(insert_res.first);
-                    } else {
-                        current_node->child_moves = std::move(next_moves);
                     }
                 }
                     // If the state is not a new one, reverts to the last node with children
@@ -145,7 +266,7 @@ solver::result::type solver::dfs(boost::optional<clock::time_point> end_time) {
         }
 
         // Sets the current node to one of its children
-        assert(states_exhausted == current_node->child_moves.empty());
+        assert(states_exhausted == !current_node->has_child_moves());
         if (!states_exhausted) {
             set_to_child();
             state.make_move(current_node->mv);
@@ -166,18 +287,35 @@ solver::result::type solver::dfs(boost::optional<clock::time_point> end_time) {
     }
 }
 
+// Pushes the current node's next non-empty stage of legal moves onto the move
+// stack. Returns false if all of its stages have been generated and are empty
+bool solver::generate_child_moves() {
+    assert(!current_node->has_child_moves());
+    assert(current_node->moves_end == move_stack.size());
+
+    while (current_node->next_stage != game_state::move_stage::NONE) {
+        state.get_legal_moves(move_stack, current_node->mv, current_node->next_stage);
+        current_node->next_stage = game_state::next_move_stage(current_node->next_stage);
+
+        res.moves_generated += move_stack.size() - current_node->moves_end;
+        current_node->moves_end = uint32_t(move_stack.size());
+        if (current_node->has_child_moves()) return true;
+    }
+    return false;
+}
+
 // Called when the current node's children have been exhausted. Travels back up
 // the search tree until it finds a node which still has children. Returns true
 // unless all children have been exhausted.
 
 // If an iterator to the current state is supplied to the function, will also
 // make sure to turn the 'live' bit off upon backtracking
-bool solver::revert_to_last_node_with_children(optional<lru_cache::item_list::iterator> cur_state) {
+bool solver::revert_to_last_node_with_children(optional<state_cache::handle> cur_state) {
     if (current_node == begin(frontier))
         return true;
 
     // Turns the 'live' bit false on the state we are backtracking out of
-    if (cur_state) cache.set_non_live(*cur_state);
+    if (cur_state) cache->set_non_live(*cur_state, res.states_searched - current_node->states_searched_before);
 
     state.undo_move(current_node->mv);
     res.depth--;
@@ -188,8 +326,8 @@ bool solver::revert_to_last_node_with_children(optional<lru_cache::item_list::it
     // (as long as the move wasn't a dominance move)
 
     if (! current_node->mv.dominance_move) {
-        if (cache.get_states_removed_from_cache() == 0) {
-            assert(cache.contains(state));
+        if (cache->get_states_removed_from_cache() == 0) {
+            assert(cache->contains(state));
         }
         LOG_DEBUG("(undo move)");
     } else {
@@ -200,14 +338,17 @@ bool solver::revert_to_last_node_with_children(optional<lru_cache::item_list::it
 
     // Gets a reference to the parent state which can be supplied if this function is
     // called recursively. This ensures that the cached state's 'live' bit is set as appropriate
-    optional<lru_cache::item_list::iterator> p_state = prev(current_node)->cache_state;
+    optional<state_cache::handle> p_state = prev(current_node)->cache_state;
 
-    // Reverts the current node to its parent and removes it
+    // Reverts the current node to its parent and removes it, along with any
+    // of its moves that were stolen from the bottom of its range
     frontier.pop_back();
     current_node = prev(end(frontier));
+    move_stack.erase(begin(move_stack) + current_node->moves_end, end(move_stack));
 
-    // If the current node now has no children, repeat
-    if (current_node->child_moves.empty()) {
+    // If the current node now has no children, and no more stages of legal
+    // moves to generate, repeat
+    if (!current_node->has_child_moves() && !generate_child_moves()) {
         return revert_to_last_node_with_children(p_state);
     } else {
         return false;
@@ -215,30 +356,251 @@ bool solver::revert_to_last_node_with_children(optional<lru_cache::item_list::it
 }
 
 void solver::set_to_child() {
-    assert(!current_node->child_moves.empty());
+    assert(current_node->has_child_moves());
+    assert(current_node->moves_end == move_stack.size());
 
-    move b = current_node->child_moves.back();
-    current_node->child_moves.pop_back();
-    frontier.emplace_back(b);
+    move b = move_stack.back();
+    move_stack.pop_back();
+    current_node->moves_end--;
+    frontier.emplace_back(b, uint32_t(move_stack.size()));
 
     current_node = prev(end(frontier));
+    current_node->states_searched_before = res.states_searched;
+}
+
+// Draws the states searched since the last poll from the budget, and says
+// how the search ends if the budget has run out or the search has been stopped
+optional<solver::result::type> solver::poll(search_budget& budget) {
+    const search_budget::limit l = budget.spend(res.states_searched - states_spent, cache->bytes_used());
+    states_spent = res.states_searched;
+
+    switch (l) {
+        case search_budget::limit::NONE:
+            break;
+        case search_budget::limit::CANCELLED:
+            return result::type::TERMINATED;
+        case search_budget::limit::DEADLINE:
+        case search_budget::limit::STATES:
+            return result::type::TIMEOUT;
+        case search_budget::limit::MEMORY:
+            return result::type::MEM_LIMIT;
+    }
+
+    if (group) {
+        if (group->stop) return result::type::TERMINATED;
+        // Once a helper has joined, the frontier is locked while it changes.
+        // Until then it is left alone, so a search nobody helps pays nothing
+        if (!shared_frontier && group->worker_count > 1) shared_frontier = true;
+    }
+    return boost::none;
+}
+
+////////////////////////////////////
+// SEARCHING WITH SEVERAL THREADS //
+////////////////////////////////////
+
+// Searches the deal with one solver per thread, all sharing this solver's
+// cache. The first solver starts at the root, and the others steal
+// unexplored moves from the shallow end of each other's frontiers. Helpers
+// that join part way through steal in the same way
+solver::result::type solver::run_parallel(search_budget& budget) {
+    search_group grp(threads_per_deal + max_helpers, budget);
+    for (uint i = 0; i < threads_per_deal; i++) {
+        grp.join(std::make_unique<solver>(init_state, cache), threads_per_deal > 1);
+    }
+    if (max_helpers > 0) {
+        std::lock_guard<std::mutex> lock(help_mutex);
+        helped = &grp;
+    }
+
+    vector<std::thread> threads;
+    for (uint i = 1; i < threads_per_deal; i++) {
+        threads.emplace_back(&solver::search_as_worker, grp.workers[i].get(), false, &budget);
+    }
+    grp.workers[0]->search_as_worker(true, &budget);
+    for (auto& t : threads) t.join();
+
+    // The helpers' solvers belong to the group, so it must outlive them
+    {
+        std::unique_lock<std::mutex> lock(help_mutex);
+        helped = nullptr;
+        helper_left.wait(lock, [&grp] { return grp.helpers == 0; });
+    }
+
+    const uint worker_count = grp.worker_count;
+    for (uint i = 0; i < worker_count; i++) {
+        const solver& w = *grp.workers[i];
+        res.states_searched += w.res.states_searched;
+        res.unique_states_searched += w.res.unique_states_searched;
+        res.backtracks += w.res.backtracks;
+        res.dominance_moves += w.res.dominance_moves;
+        res.allocations += w.res.allocations;
+        res.moves_generated += w.res.moves_generated;
+        res.max_depth = max(res.max_depth, w.res.max_depth);
+    }
+    res.depth = grp.workers[0]->res.depth;
+
+    if (!grp.outcome) return result::type::UNSOLVABLE;
+
+    // Takes on the path of the solver that found the solution
+    if (*grp.outcome == result::type::SOLVED) {
+        const solver& w = *grp.workers[grp.winner];
+        frontier.clear();
+        frontier.push_back(root);
+        for (const move& m : w.base_path) frontier.emplace_back(m);
+        for (auto i = next(begin(w.frontier)); i != end(w.frontier); i++) frontier.push_back(*i);
+        current_node = prev(end(frontier));
+        res.depth = frontier.size() - 1;
+    }
+    return *grp.outcome;
+}
+
+void solver::search_as_worker(bool has_work, search_budget* budget) {
+    while (has_work || steal_work(*budget)) {
+        result::type t = dfs(*budget);
+        if (t != result::type::UNSOLVABLE) {
+            group->finish(t, worker_id);
+            return;
+        }
+        has_work = false;
+        group->busy--;
+    }
+}
+
+// Waits until a move can be taken from another solver, or the search is over
+bool solver::steal_work(search_budget& budget) {
+    while (!group->stop) {
+        optional<result::type> stop = poll(budget);
+        if (stop) {
+            group->finish(*stop, worker_id);
+            return false;
+        }
+
+        // Helpers may have joined since the last look
+        const uint worker_count = group->worker_count;
+        for (uint i = 1; i < worker_count; i++) {
+            uint victim_id = (worker_id + i) % worker_count;
+            solver& victim = *group->workers[victim_id];
+            if (!victim.shared_frontier) continue;
+            vector<move> path;
+            optional<move> stolen;
+
+            {
+                std::lock_guard<std::mutex> victim_lock(group->locks[victim_id]);
+
+                // The shallowest node with unexplored moves has the most work under it
+                auto n = std::find_if(begin(victim.frontier), end(victim.frontier),
+                                      [](const node& nd) { return nd.has_child_moves(); });
+                if (n == end(victim.frontier)) continue;
+
+                // Takes the move the victim would otherwise explore last
+                group->busy++;
+                stolen = victim.move_stack[n->moves_begin++];
+
+                path = victim.base_path;
+                for (auto j = next(begin(victim.frontier)); j != next(n); j++) path.push_back(j->mv);
+            }
+
+            take_work(std::move(path), *stolen);
+            return true;
+        }
+
+        if (group->busy == 0) return false;
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+// Follows the given path from the initial state, and makes the stolen move
+// the only child of the new root. The state must be at the root of the
+// (exhausted) frontier
+void solver::take_work(vector<move> path, move m) {
+    std::unique_lock<std::mutex> frontier_lock = lock_frontier();
+
+    for (auto i = base_path.rbegin(); i != base_path.rend(); i++) state.undo_move(*i);
+    for (const move& pm : path) state.make_move(pm);
+    base_path = std::move(path);
+
+    frontier.clear();
+    move_stack.clear();
+    move_stack.push_back(m);
+    frontier.push_back(root);
+    frontier.front().moves_end = 1;
+    current_node = begin(frontier);
+
+    set_to_child();
+    state.make_move(current_node->mv);
+    res.depth = base_path.size() + 1;
+    res.max_depth = max(res.depth, res.max_depth);
+    if (current_node->mv.dominance_move) res.dominance_moves++;
+}
+
+std::unique_lock<std::mutex> solver::lock_frontier() {
+    return shared_frontier ? std::unique_lock<std::mutex>(group->locks[worker_id]) : std::unique_lock<std::mutex>();
+}
+
+void solver::allow_helpers(uint n) {
+    max_helpers = shared_cache ? n : 0;
+}
+
+bool solver::can_take_help(const cache_options& opts, uint threads) {
+    return cache_options_for(opts, threads).type == state_cache::backend::SHARED_TRANSPOSITION_TABLE;
+}
+
+bool solver::help() {
+    std::unique_lock<std::mutex> lock(help_mutex);
+    if (!helped || helped->stop || helped->worker_count == helped->workers.size()) return false;
+
+    // Helpers share the cache, so the search stays within its memory budget
+    // and no helper searches a state another has already searched
+    search_group& grp = *helped;
+    grp.join(std::make_unique<solver>(init_state, cache), true);
+    solver& w = *grp.workers[grp.worker_count - 1];
+    grp.helpers++;
+    lock.unlock();
+
+    w.search_as_worker(false, &grp.budget);
+
+    lock.lock();
+    grp.helpers--;
+    helper_left.notify_all();
+    return true;
+}
+
+// Frees the cache, which for a large search can take a while, and returns how
+// long it took. The solution can still be printed afterwards
+std::chrono::milliseconds solver::release_cache() {
+    const clock::time_point start_time = clock::now();
+    cache.reset();
+    return std::chrono::duration_cast<millisec>(clock::now() - start_time);
+}
+
+vector<move> solver::get_solution() const {
+    vector<move> solution;
+    if (res.sol_type != result::type::SOLVED || res.states_searched <= 1) return solution;
+
+    solution.reserve(frontier.size() - 1);
+    for (auto i = std::next(begin(frontier)); i != end(frontier); i++) {
+        solution.push_back(i->mv);
+    }
+    return solution;
 }
 
 void solver::print_solution() const {
+    print_solution(init_state, get_solution());
+}
+
+// Prints each state on the way from the given one to the solved state
+void solver::print_solution(game_state state, const vector<move>& solution) {
     std::flush(clog);
     std::flush(cout);
 
-    auto i = begin(frontier);
-    game_state state_copy = init_state;
-
     cout << "Solution:\n";
-    cout << state_copy << "\n";
+    cout << state << "\n";
 
-    if (res.states_searched > 1) {
-        while (++i != end(frontier)) {
-            state_copy.make_move(i->mv);
-            cout << state_copy << "\n";
-        }
+    for (const move& m : solution) {
+        state.make_move(m);
+        cout << state << "\n";
     }
     cout << "\n";
 }
@@ -274,9 +636,19 @@ std::ostream& operator<< (std::ostream& out, const solver::result& r) {
             << "States Removed From Cache: " << r.states_removed_from_cache  << "\n"
             << "Final States In Cache: "     << r.cache_size                 << "\n"
             << "Final Buckets In Cache: "    << r.cache_bucket_count         << "\n"
+            << "Final Cache Bytes: "         << r.cache_bytes                << "\n"
+            << "Peak Cache Bytes: "          << r.peak_cache_bytes           << "\n"
+            << "Cache Bytes Per State: "     << r.cache_bytes_per_state      << "\n"
+            << "Mean Eviction Scan Length: " << r.mean_eviction_scan         << "\n"
+            << "Max Eviction Scan Length: "  << r.max_eviction_scan          << "\n"
+            << "Dead States Kept: "          << r.dead_states                << "\n"
+            << "Dead State Hits: "           << r.dead_state_hits            << "\n"
+            << "Allocations Per Node: "      << r.allocations_per_node       << "\n"
+            << "Moves Generated Per State: " << r.moves_generated_per_state  << "\n"
             << "Maximum Search Depth: "      << r.max_depth                  << "\n"
             << "Final Search Depth: "        << r.depth                      << "\n"
-            << "Time Taken (milliseconds): " << r.time.count()               << "\n";
+            << "Time Taken (milliseconds): " << r.time.count()               << "\n"
+            << "Teardown Time (milliseconds): " << r.teardown_time.count()   << "\n";
 }
 
 void solver::print_header(long t, command_line_helper::streamliner_opt stream_opt) {
@@ -286,6 +658,7 @@ void solver::print_header(long t, command_line_helper::streamliner_opt stream_op
                 "Attempted Seed"
                 ", Outcome"
                 ", Time Taken(ms)"
+                ", Teardown Time(ms)"
                 ", States Searched"
                 ", Unique States Searched"
                 ", Backtracks"
@@ -293,6 +666,8 @@ void solver::print_header(long t, command_line_helper::streamliner_opt stream_op
                 ", States Removed From Cache"
                 ", Final States In Cache"
                 ", Final Buckets In Cache"
+                ", Final Cache Bytes"
+                ", Peak Cache Bytes"
                 ", Maximum Search Depth"
                 ", Final Search Depth"
                 ", (Non-Streamliner Results:) ";
@@ -300,6 +675,7 @@ void solver::print_header(long t, command_line_helper::streamliner_opt stream_op
     cout << "Attempted Seed"
             ", Outcome"
             ", Time Taken(ms)"
+            ", Teardown Time(ms)"
             ", States Searched"
             ", Unique States Searched"
             ", Backtracks"
@@ -307,6 +683,8 @@ void solver::print_header(long t, command_line_helper::streamliner_opt stream_op
             ", States Removed From Cache"
             ", Final States In Cache"
             ", Final Buckets In Cache"
+            ", Final Cache Bytes"
+            ", Peak Cache Bytes"
             ", Maximum Search Depth"
             ", Final Search Depth"
             ", Overall Result"
@@ -317,6 +695,7 @@ void solver::print_header(long t, command_line_helper::streamliner_opt stream_op
 void solver::print_result_csv(solver::result res) {
     cout << ", " << res.sol_type
          << ", " << res.time.count()
+         << ", " << res.teardown_time.count()
          << ", " << res.states_searched
          << ", " << res.unique_states_searched
          << ", " << res.backtracks
@@ -324,14 +703,12 @@ void solver::print_result_csv(solver::result res) {
          << ", " << res.states_removed_from_cache
          << ", " << res.cache_size
          << ", " << res.cache_bucket_count
+         << ", " << res.cache_bytes
+         << ", " << res.peak_cache_bytes
          << ", " << res.max_depth
          << ", " << res.depth;
 }
 
-void solver::print_null_seed_info() {
-    cout << ", , , , , , , , , , , ";
-}
-
-const vector<solver::node> solver::get_frontier() const {
+const vector<solver::node>& solver::get_frontier() const {
     return frontier;
 }
@@ -28,20 +28,31 @@
 #include <vector>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
+#include "search_budget.h"
 #include "../game/global_cache.h"
 #include "../game/sol_rules.h"
 #include "../input-output/input/command_line_helper.h"
 
 class solver {
 public:
-    lru_cache cache;
+    std::shared_ptr<state_cache> cache;
 
+    // One level of the search path: the move made to reach it, the range of
+    // the move stack holding the moves still to be tried from it, and the
+    // stage of its legal moves to generate once that range is exhausted
     struct node {
-        node(move) noexcept;
+        node(move, uint32_t = 0) noexcept;
+        bool has_child_moves() const;
+
         const move mv;
-        std::vector<move> child_moves;
-        boost::optional<lru_cache::item_list::iterator> cache_state; // Optional, as dominance moves aren't cached
+        boost::optional<state_cache::handle> cache_state; // Optional, as dominance moves aren't cached
+        uint64_t states_searched_before; // So the size of its subtree is known when it is backtracked out of
+        uint32_t moves_begin;
+        uint32_t moves_end;
+        game_state::move_stage next_stage;
     };
 
     struct result {
@@ -53,45 +64,113 @@ public:
         uint64_t backtracks;
         uint64_t dominance_moves;
         uint64_t states_removed_from_cache;
-        lru_cache::item_list::size_type cache_size;
-        lru_cache::item_list::size_type cache_bucket_count;
+        uint64_t cache_size;
+        uint64_t cache_bucket_count;
+        double cache_bytes_per_state;
+        uint64_t cache_bytes;
+        uint64_t peak_cache_bytes;
+        double mean_eviction_scan;
+        uint64_t max_eviction_scan;
+        uint64_t dead_states;
+        uint64_t dead_state_hits;
+        uint64_t allocations;
+        double allocations_per_node;
+        uint64_t moves_generated;
+        double moves_generated_per_state;
         uint64_t max_depth;
         uint64_t depth;
         std::chrono::milliseconds time;
+        std::chrono::milliseconds teardown_time;
     };
 
     explicit solver(const game_state&, uint64_t);
+    // With more than one thread, the threads search the deal together
+    solver(const game_state&, const cache_options&, uint = 1);
+    // Searches using a cache which may be shared with other solvers
+    solver(const game_state&, std::shared_ptr<state_cache>);
+    // The frontier and cache can be large, so a solver is never copied. Take
+    // the solution from it instead
+    solver(const solver&) = delete;
+    solver& operator=(const solver&) = delete;
 
     result run(boost::optional<std::chrono::milliseconds> = boost::none);
-
+    // Searches until the budget runs out. A search that runs out of time or
+    // of states times out, and one that is cancelled is TERMINATED
+    result run(search_budget&);
+    std::chrono::milliseconds release_cache();
+
+    // Lets up to this many other threads join each run, by calling help().
+    // Helpers search with the solver's cache, so only a solver whose cache is
+    // the shared transposition table can take them
+    void allow_helpers(uint);
+    static bool can_take_help(const cache_options&, uint = 1);
+    // Joins the run in progress on another thread, stealing work from its
+    // searchers until the search is over. Returns false, straight away, if
+    // there is no run that can take help
+    bool help();
+
+    // The moves from the initial state to the solved one, if solved
+    std::vector<move> get_solution() const;
     void print_solution() const;
+    static void print_solution(game_state, const std::vector<move>&);
     static void print_header(long, command_line_helper::streamliner_opt);
     static void print_result_csv(solver::result);
-    static void print_null_seed_info();
-    const std::vector<node> get_frontier() const;
+    const std::vector<node>& get_frontier() const;
 
     const game_state init_state;
 
 private:
-    typedef std::chrono::high_resolution_clock clock;
+    typedef search_budget::clock clock;
     typedef std::chrono::milliseconds millisec;
 
-    result::type dfs(boost::optional<clock::time_point> = boost::none);
+    struct search_group;
+
+    // How many states are searched between looks at the budget
+    static const uint32_t poll_interval;
+
+    result::type dfs(search_budget&);
+    result::type search(search_budget&);
+    boost::optional<result::type> poll(search_budget&);
 
-    bool revert_to_last_node_with_children(boost::optional<lru_cache::item_list::iterator> = boost::none);
+    /* Searching with several threads */
+
+    result::type run_parallel(search_budget&);
+    void search_as_worker(bool, search_budget*);
+    bool steal_work(search_budget&);
+    void take_work(std::vector<move>, move);
+    std::unique_lock<std::mutex> lock_frontier();
+
+    bool generate_child_moves();
+    bool revert_to_last_node_with_children(boost::optional<state_cache::handle> = boost::none);
     void set_to_child();
 
     game_state state;
     std::vector<node> frontier;
+    std::vector<move> move_stack; // The moves still to be tried from every level, deepest last
 
     result res;
 
     node root;
     std::vector<node>::iterator current_node;
+
+    uint threads_per_deal;
+    search_group* group;         // The solvers this one is searching with, if any
+    uint worker_id;
+    std::vector<move> base_path; // The moves from the initial state to the root of the frontier
+    uint64_t states_spent;       // The states searched that have been drawn from the budget
+    // Whether others may steal from the frontier, so that it must be locked
+    // while it is changed
+    std::atomic<bool> shared_frontier;
+
+    // Helpers join a run through the search group it publishes
+    bool shared_cache; // Whether the cache can be searched by several threads
+    uint max_helpers;
+    std::mutex help_mutex;
+    std::condition_variable helper_left;
+    search_group* helped;
 };
 
 std::ostream& operator<< (std::ostream&, const solver::result::type&);
 std::ostream& operator<< (std::ostream&, const solver::result&);
-void sigint_handler(int i);
 
 #endif //SOLVITAIRE_SOLVER_H
@@ -45,3 +45,11 @@ TEST(FreeCell, SimpleUnsolvable) {
 TEST(FreeCell, ComplexUnsolvable) {
     EXPECT_FALSE(th::is_solvable(path + "ComplexUnsolvable.json", type));
 }
+
+TEST(FreeCell, ComplexSolvableThreaded) {
+    EXPECT_TRUE(th::is_solvable(path + "ComplexSolvable.json", type, 3));
+}
+
+TEST(FreeCell, ComplexUnsolvableThreaded) {
+    EXPECT_FALSE(th::is_solvable(path + "ComplexUnsolvable.json", type, 3));
+}
@@ -45,3 +45,11 @@ TEST(Klondike, SimpleUnsolvable) {
 TEST(Klondike, ComplexUnsolvable) {
     EXPECT_FALSE(th::is_solvable(path + "ComplexUnsolvable.json", type));
 }
+
+TEST(Klondike, ComplexSolvableThreaded) {
+    EXPECT_TRUE(th::is_solvable(path + "ComplexSolvable.json", type, 3));
+}
+
+TEST(Klondike, ComplexUnsolvableThreaded) {
+    EXPECT_FALSE(th::is_solvable(path + "ComplexUnsolvable.json", type, 3));
+}
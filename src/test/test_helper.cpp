@@ -40,14 +40,21 @@ typedef std::initializer_list<std::initializer_list<std::string>> string_il;
 typedef game_state::streamliner_options sos;
 
 
-bool test_helper::is_solvable(const std::string& input_file, const std::string& preset_type) {
+bool test_helper::is_solvable(const std::string& input_file, const std::string& preset_type, uint threads) {
     const Document in_doc = json_helper::get_file_json(input_file);
     const sol_rules rules = rules_parser::from_preset(preset_type);
 
     game_state gs(rules, in_doc, sos::NONE);
-    solver sol(gs, 1000000);
+    solver sol(gs, cache_options(1000000), threads);
+
+    if (sol.run().sol_type != solver::result::type::SOLVED) return false;
 
-    return sol.run().sol_type == solver::result::type::SOLVED;
+    // The solution must lead from the deal to a solved state
+    for (const move& m : sol.get_solution()) {
+        gs.make_move(m);
+    }
+    EXPECT_TRUE(gs.is_solved());
+    return true;
 }
 
 void test_helper::run_foundations_dominance_test(sol_rules::build_policy policy,
@@ -71,7 +78,7 @@ void test_helper::run_foundations_dominance_test(sol_rules::build_policy policy,
     solver sol(gs, 1000000);
     sol.run();
 
-    auto frontier = sol.get_frontier();
+    auto& frontier = sol.get_frontier();
     auto i = std::begin(frontier);
 
     for (card c : cards) {
@@ -81,7 +88,7 @@ void test_helper::run_foundations_dominance_test(sol_rules::build_policy policy,
         ASSERT_TRUE(i->mv.to >= 0 && i->mv.to <= 4);
         gs.make_move(i->mv);
     }
-    ASSERT_TRUE(i->child_moves.empty());
+    ASSERT_FALSE(i->has_child_moves());
 }
 
 void test_helper::expected_moves_test(sol_rules sr,
@@ -143,6 +150,41 @@ void test_helper::k_plus_stock_test
     ASSERT_EQ(gs.get_data(), game_state(sr, piles).get_data()) << gs;
 }
 
+// Makes random moves from the state, backtracking now and then as the solver
+// would, and calls the check on each state reached with the move that led to
+// it. As in the solver, a dominance move is made as soon as there is one, and
+// undone along with the move before it
+void test_helper::random_walk(game_state& gs, uint steps, uint seed,
+                              const std::function<void(game_state&, move)>& check) {
+    std::mt19937 rng(seed);
+    vector<move> made;
+
+    for (uint i = 0; i < steps; i++) {
+        boost::optional<move> dom = gs.get_dominance_move();
+        if (dom) {
+            made.push_back(*dom);
+            gs.make_move(*dom);
+            continue;
+        }
+
+        move parent = made.empty() ? move(move::mtype::regular) : made.back();
+        check(gs, parent);
+
+        vector<move> moves = gs.get_legal_moves(parent);
+        if (!made.empty() && (moves.empty() || rng() % 4 == 0)) {
+            do {
+                gs.undo_move(made.back());
+                made.pop_back();
+            } while (!made.empty() && made.back().dominance_move);
+        } else if (!moves.empty()) {
+            made.push_back(moves[rng() % moves.size()]);
+            gs.make_move(made.back());
+        } else {
+            return;
+        }
+    }
+}
+
 uint8_t test_helper::cards_in_founds(game_state& gs) {
     uint8_t sz = 0;
     for (auto found : gs.foundations) {
@@ -151,6 +193,71 @@ uint8_t test_helper::cards_in_founds(game_state& gs) {
     return sz;
 }
 
+// Checks the card location index against a scan of the piles: every card
+// has a slot holding its location, and no other slots are in use
+void test_helper::check_card_locations(const game_state& gs) {
+    if (gs.card_copies == 0) return;
+
+    size_t cards = 0;
+    for (pile::ref pr = 0; pr < gs.piles.size(); pr++) {
+        const pile& p = gs.piles[pr];
+        for (pile::size_type pos = 0; pos < p.size(); pos++) {
+            card c = p[pile::size_type(p.size() - 1 - pos)];
+            auto slots = gs.find_card(c);
+            bool found = std::any_of(slots.first, slots.second, [&](const game_state::card_location& l) {
+                return l.pr == pr && l.pos == pos;
+            });
+            EXPECT_TRUE(found) << c.to_string() << " at " << int(pos) << " of pile " << int(pr);
+            EXPECT_EQ(gs.is_exposed({pr, pos}), pos + 1 == p.size());
+        }
+        cards += p.size();
+    }
+
+    auto used = std::count_if(begin(gs.card_locations), end(gs.card_locations),
+                              [](const game_state::card_location& l) { return l.pr != 255; });
+    EXPECT_EQ(cards, size_t(used));
+}
+
+// Checks the precomputed card relations against the rules they are computed
+// from, for every pair of cards and every foundations base
+void test_helper::check_card_relations(game_state gs) {
+    const sol_rules& r = gs.rules;
+
+    for (card::rank_t base = 1; base <= r.max_rank; base++) {
+        gs.set_foundations_base(base);
+        const game_state::card_relations& rels = *gs.relations;
+
+        for (card::suit_t a_suit = 0; a_suit < 4; a_suit++) {
+            for (card::rank_t a_rank = 1; a_rank <= r.max_rank; a_rank++) {
+                for (card::suit_t b_suit = 0; b_suit < 4; b_suit++) {
+                    for (card::rank_t b_rank = 1; b_rank <= r.max_rank; b_rank++) {
+                        card a(a_suit, a_rank), b(b_suit, b_rank);
+                        SCOPED_TRACE(b.to_string() + " on " + a.to_string() + ", base " + std::to_string(base));
+
+                        bool tableau = gs.is_next_legal_card(r.build_pol, a, b);
+                        EXPECT_EQ(tableau, game_state::is_related(rels.tableau, a, b));
+                        EXPECT_EQ(tableau, game_state::is_related(rels.tableau_onto, b, a));
+                        EXPECT_EQ(gs.is_next_legal_card(r.built_group_pol, a, b),
+                                  game_state::is_related(rels.built_group, a, b));
+                        EXPECT_EQ(gs.is_next_legal_card(r.sequence_build_pol, a, b),
+                                  game_state::is_related(rels.sequence, a, b));
+                        EXPECT_EQ(gs.is_next_legal_card(r.accordion_pol, a, b),
+                                  game_state::is_related(rels.accordion, a, b));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The legal moves of a state that keeps the tableau top-card index, found
+// with the pairwise checks of each tableau pile instead
+vector<move> test_helper::pairwise_legal_moves(game_state gs, move parent) {
+    EXPECT_TRUE(gs.top_card_index);
+    gs.top_card_index = false;
+    return gs.get_legal_moves(parent);
+}
+
 ostream& operator <<(ostream& os, const move& m) {
     return os << "move:(" << int(m.from)
               << ","    << int(m.to)
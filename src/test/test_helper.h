@@ -25,6 +25,7 @@
 #define SOLVITAIRE_TEST_HELPER_H
 
 #include <string>
+#include <functional>
 
 #include "../main/game/sol_rules.h"
 #include "../main/game/card.h"
@@ -34,7 +35,7 @@
 
 class test_helper {
 public:
-    static bool is_solvable(const std::string&, const std::string&);
+    static bool is_solvable(const std::string&, const std::string&, uint = 1);
     static void run_foundations_dominance_test(sol_rules::build_policy policy,
                                                std::vector<card> cards);
     static void expected_moves_test(sol_rules sr, std::initializer_list<std::initializer_list<std::string>>,
@@ -50,7 +51,11 @@ public:
             , card
             );
     static bool moves_eq(std::vector<move>&, std::vector<move>&);
+    static void random_walk(game_state&, uint, uint, const std::function<void(game_state&, move)>&);
     static uint8_t cards_in_founds(game_state&);
+    static void check_card_locations(const game_state&);
+    static void check_card_relations(game_state);
+    static std::vector<move> pairwise_legal_moves(game_state, move);
 };
 
 std::ostream& operator <<(std::ostream&, const move&);
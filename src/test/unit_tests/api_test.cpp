@@ -0,0 +1,245 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../main/api/solvitaire.h"
+#include "../../main/solver/solver.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+
+using std::vector;
+
+static const char* four_rank_free_cell = R"({
+  "tableau piles": {"count": 4, "build policy": "red-black"},
+  "cells": {"count": 1},
+  "max rank": 4
+})";
+
+static const char* four_rank_deal = R"({
+  "tableau piles": [
+    ["4C","3C","2C","AC"],
+    ["4D","3D","2D","AD"],
+    ["4H","3H","2H","AH"],
+    ["4S","3S","2S","AS"]
+  ]
+})";
+
+TEST(Api, SolvesSeed) {
+    solvitaire_rules* rules = solvitaire_rules_from_preset("black-hole");
+    ASSERT_NE(rules, nullptr);
+    solvitaire_deal* deal = solvitaire_deal_from_seed(rules, 3);
+    ASSERT_NE(deal, nullptr);
+    solvitaire_rules_free(rules);
+
+    solvitaire_options opts;
+    solvitaire_options_init(&opts);
+    opts.cache_capacity = 100000;
+    solvitaire_solver* s = solvitaire_solver_create(deal, &opts);
+    ASSERT_NE(s, nullptr);
+    solvitaire_deal_free(deal);
+
+    solvitaire_result res;
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+
+    // The same search as solving the deal directly
+    game_state gs(rules_parser::from_preset("black-hole"), 3, game_state::streamliner_options::NONE);
+    solver sol(gs, cache_options(100000));
+    solver::result exp = sol.run();
+    ASSERT_EQ(exp.sol_type, solver::result::type::SOLVED);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_SOLVED);
+    ASSERT_EQ(res.states_searched, exp.states_searched);
+    ASSERT_EQ(res.solution_length, sol.get_solution().size());
+
+    // Every card of the tableau ends up in the hole
+    vector<solvitaire_move> moves(res.solution_length);
+    ASSERT_EQ(solvitaire_solver_solution(s, moves.data(), moves.size()), res.solution_length);
+    for (const solvitaire_move& m : moves) {
+        ASSERT_EQ(m.type, SOLVITAIRE_MOVE_REGULAR);
+        ASSERT_EQ(m.from.kind, SOLVITAIRE_PILE_TABLEAU);
+        ASSERT_LT(m.from.index, 17);
+        ASSERT_EQ(m.to.kind, SOLVITAIRE_PILE_HOLE);
+        ASSERT_NE(m.card[0], '\0');
+    }
+
+    solvitaire_solver_free(s);
+}
+
+TEST(Api, SolvesJsonDeal) {
+    solvitaire_rules* rules = solvitaire_rules_from_json(four_rank_free_cell);
+    ASSERT_NE(rules, nullptr) << solvitaire_last_error();
+    solvitaire_deal* deal = solvitaire_deal_from_json(rules, four_rank_deal);
+    ASSERT_NE(deal, nullptr) << solvitaire_last_error();
+    solvitaire_solver* s = solvitaire_solver_create(deal, nullptr);
+    ASSERT_NE(s, nullptr);
+
+    solvitaire_result res;
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_SOLVED);
+    ASSERT_EQ(res.solution_length, 16u);
+
+    // Each ace is on top of its pile, so the first move plays one of them
+    solvitaire_move first;
+    ASSERT_EQ(solvitaire_solver_solution(s, &first, 1), 16u);
+    ASSERT_EQ(first.from.kind, SOLVITAIRE_PILE_TABLEAU);
+    ASSERT_EQ(first.to.kind, SOLVITAIRE_PILE_FOUNDATION);
+    ASSERT_EQ(first.card[0], 'A');
+
+    solvitaire_solver_free(s);
+    solvitaire_deal_free(deal);
+    solvitaire_rules_free(rules);
+}
+
+TEST(Api, SolvesGapsDeal) {
+    // The cells come before the sequences among the piles, so the sequences
+    // aren't the first piles
+    solvitaire_rules* rules = solvitaire_rules_from_json(R"({
+      "foundations": {"present": false},
+      "tableau piles": {"count": 0},
+      "sequences": {"count": 4, "direction": "L", "build policy": "same-suit"},
+      "cells": {"count": 2},
+      "max rank": 4
+    })");
+    ASSERT_NE(rules, nullptr) << solvitaire_last_error();
+    solvitaire_deal* deal = solvitaire_deal_from_json(rules, R"({
+      "sequences": [
+        ["2C","4S","4C",""],
+        ["2D","3S","4D",""],
+        ["2S","3C","3D",""],
+        ["2H","3H","4H",""]
+      ]
+    })");
+    ASSERT_NE(deal, nullptr) << solvitaire_last_error();
+    solvitaire_solver* s = solvitaire_solver_create(deal, nullptr);
+    ASSERT_NE(s, nullptr);
+
+    solvitaire_result res;
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_SOLVED);
+    vector<solvitaire_move> moves(res.solution_length);
+    ASSERT_EQ(solvitaire_solver_solution(s, moves.data(), moves.size()), res.solution_length);
+
+    // Replays the moves on the deal. Positions count from the top card of a
+    // sequence, which is the last one dealt
+    vector<vector<std::string>> seqs = {{"2C","4S","4C",""}, {"2D","3S","4D",""},
+                                        {"2S","3C","3D",""}, {"2H","3H","4H",""}};
+    for (const solvitaire_move& m : moves) {
+        ASSERT_EQ(m.type, SOLVITAIRE_MOVE_SEQUENCE);
+        ASSERT_EQ(m.from.kind, SOLVITAIRE_PILE_SEQUENCE);
+        ASSERT_EQ(m.to.kind, SOLVITAIRE_PILE_SEQUENCE);
+        ASSERT_LT(m.from.index, 4);
+        ASSERT_LT(m.to.index, 4);
+        ASSERT_LT(m.from.position, 4);
+        ASSERT_LT(m.to.position, 4);
+
+        std::string& from = seqs[m.from.index][3 - m.from.position];
+        std::string& to = seqs[m.to.index][3 - m.to.position];
+        ASSERT_EQ(from, m.card);
+        ASSERT_EQ(to, "");
+        std::swap(from, to);
+    }
+
+    // Each sequence ends as a suit in order, with the gap on its right
+    for (const auto& seq : seqs) {
+        ASSERT_EQ(seq[3], "");
+        for (size_t i = 0; i < 3; i++) {
+            ASSERT_EQ(seq[i][0], char('2' + i));
+            ASSERT_EQ(seq[i][1], seq[0][1]);
+        }
+    }
+
+    solvitaire_solver_free(s);
+    solvitaire_deal_free(deal);
+    solvitaire_rules_free(rules);
+}
+
+TEST(Api, Errors) {
+    ASSERT_EQ(solvitaire_rules_from_preset("no-such-game"), nullptr);
+    ASSERT_STRNE(solvitaire_last_error(), "");
+    ASSERT_EQ(solvitaire_rules_from_json("not json"), nullptr);
+    ASSERT_EQ(solvitaire_rules_from_json(R"({"max rank": "high"})"), nullptr);
+
+    solvitaire_rules* rules = solvitaire_rules_from_json(four_rank_free_cell);
+    ASSERT_EQ(solvitaire_deal_from_json(rules, "not json"), nullptr);
+    ASSERT_EQ(solvitaire_deal_from_json(rules, R"({"tableau piles": [["AS"]]})"), nullptr);
+    ASSERT_EQ(solvitaire_deal_from_json(rules, R"({"tableau piles": [["ZZ"], [], [], []]})"), nullptr);
+    ASSERT_EQ(solvitaire_deal_from_json(rules, R"({"tableau piles": [["5S"], [], [], []]})"), nullptr);
+
+    // A solver only runs once
+    solvitaire_deal* deal = solvitaire_deal_from_json(rules, four_rank_deal);
+    solvitaire_solver* s = solvitaire_solver_create(deal, nullptr);
+    solvitaire_result res;
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_NE(solvitaire_solver_run(s, &res), 0);
+
+    solvitaire_solver_free(s);
+    solvitaire_deal_free(deal);
+    solvitaire_rules_free(rules);
+}
+
+TEST(Api, CancelsAndTimesOut) {
+    solvitaire_rules* rules = solvitaire_rules_from_preset("spider");
+    // A deal that takes far longer than the test to solve
+    solvitaire_deal* deal = solvitaire_deal_from_seed(rules, 1);
+
+    solvitaire_options opts;
+    solvitaire_options_init(&opts);
+    opts.cache_capacity = 100000;
+    solvitaire_result res;
+
+    // From another thread while running
+    solvitaire_solver* s = solvitaire_solver_create(deal, &opts);
+    std::thread runner([&] { solvitaire_solver_run(s, &res); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    solvitaire_solver_cancel(s);
+    runner.join();
+    ASSERT_EQ(res.outcome, SOLVITAIRE_CANCELLED);
+    ASSERT_EQ(res.solution_length, 0u);
+    solvitaire_solver_free(s);
+
+    // Before running, with several threads
+    opts.threads = 2;
+    s = solvitaire_solver_create(deal, &opts);
+    solvitaire_solver_cancel(s);
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_CANCELLED);
+    solvitaire_solver_free(s);
+
+    opts.threads = 1;
+    opts.timeout_ms = 50;
+    s = solvitaire_solver_create(deal, &opts);
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_TIMEOUT);
+    solvitaire_solver_free(s);
+
+    opts.timeout_ms = 0;
+    opts.state_limit = 1000;
+    s = solvitaire_solver_create(deal, &opts);
+    ASSERT_EQ(solvitaire_solver_run(s, &res), 0);
+    ASSERT_EQ(res.outcome, SOLVITAIRE_TIMEOUT);
+    ASSERT_GE(res.states_searched, 1000u);
+    solvitaire_solver_free(s);
+
+    solvitaire_deal_free(deal);
+    solvitaire_rules_free(rules);
+}
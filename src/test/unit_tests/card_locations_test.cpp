@@ -0,0 +1,52 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <gtest/gtest.h>
+
+#include "../test_helper.h"
+#include "../../main/game/search-state/game_state.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+
+typedef game_state::streamliner_options sos;
+
+// The presets that keep the index: those whose dominance moves look cards
+// up, and the Gaps games, whose move generation does
+static const std::vector<std::string> indexed_presets = {
+        "klondike", "free-cell", "canfield", "alpha-star", "gaps-basic-variant", "gaps-one-deal"
+};
+
+TEST(CardLocations, MatchDeal) {
+    for (const auto& preset : indexed_presets) {
+        SCOPED_TRACE(preset);
+        test_helper::check_card_locations(game_state(rules_parser::from_preset(preset), 1, sos::NONE));
+    }
+}
+
+TEST(CardLocations, FollowMoves) {
+    for (const auto& preset : indexed_presets) {
+        SCOPED_TRACE(preset);
+        for (uint seed = 1; seed <= 3; seed++) {
+            game_state gs(rules_parser::from_preset(preset), seed, sos::BOTH);
+            test_helper::random_walk(gs, 300, seed, [](game_state& state, move) {
+                test_helper::check_card_locations(state);
+            });
+        }
+    }
+}
@@ -28,6 +28,8 @@
 
 #include "../../main/input-output/input/json-parsing/deal_parser.h"
 #include "../../main/input-output/input/json-parsing/json_helper.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+#include "../../main/game/search-state/game_state.h"
 
 using namespace std;
 using namespace rapidjson;
@@ -140,6 +142,50 @@ TEST(DealParser, IllegalPileType) {
 )");
 }
 
+// A deal with the given cards in its first tableau pile, and the others empty
+static Document tableau_deal(const vector<string>& first_pile, int pile_count) {
+    string json = R"({"tableau piles": [[)";
+    for (size_t i = 0; i < first_pile.size(); i++) json += (i == 0 ? "\"" : ",\"") + first_pile[i] + "\"";
+    json += "]";
+    for (int i = 1; i < pile_count; i++) json += ",[]";
+    json += "]}";
+
+    Document doc;
+    doc.Parse(json.c_str());
+    return doc;
+}
+
+TEST(DealParser, OversizedPile) {
+    // Matches the schema, but no pile can hold 150 cards
+    const vector<string> ranks = {"A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"};
+    vector<string> cards;
+    for (int i = 0; i < 150; i++) cards.push_back(ranks[i % 13] + "SHCD"[(i / 13) % 4]);
+    const Document doc = tableau_deal(cards, 10);
+    ASSERT_FALSE(doc.HasParseError());
+
+    const sol_rules rules = rules_parser::from_preset("spider");
+    ASSERT_THROW(game_state(rules, doc, game_state::streamliner_options::NONE), runtime_error);
+}
+
+TEST(DealParser, RepeatedCards) {
+    const Document doc = tableau_deal({"AS", "AS"}, 8);
+    const sol_rules rules = rules_parser::from_preset("free-cell");
+    ASSERT_THROW(game_state(rules, doc, game_state::streamliner_options::NONE), runtime_error);
+}
+
+TEST(DealParser, UnknownCards) {
+    const sol_rules rules = rules_parser::from_preset("free-cell");
+    for (const char* c : {"ZZ", "0S", "14D", "1", "S", "10SS", "AX"}) {
+        ASSERT_THROW(game_state(rules, tableau_deal({c}, 8), game_state::streamliner_options::NONE), runtime_error) << c;
+    }
+    ASSERT_NO_THROW(game_state(rules, tableau_deal({"10S"}, 8), game_state::streamliner_options::NONE));
+
+    // A card can be well formed but above the ranks of the game
+    const sol_rules small_rules = rules_parser::from_preset("-test-free-cell");
+    ASSERT_THROW(game_state(small_rules, tableau_deal({"5C"}, small_rules.tableau_pile_count),
+                            game_state::streamliner_options::NONE), runtime_error);
+}
+
 void run_deal_parser_test(bool validity, const char* json) {
     Document in_doc;
     in_doc.Parse(json);
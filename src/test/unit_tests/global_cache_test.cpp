@@ -21,6 +21,11 @@
 // Created by thecharlesblake on 1/11/18.
 //
 
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <random>
+
 #include <gtest/gtest.h>
 
 #include "../test_helper.h"
@@ -95,3 +100,279 @@ TEST(GlobalCache, CommutativeCells) {
     ASSERT_TRUE (cache.contains(game_state(rules, {{},{"4C"},{"5D"}})));
     ASSERT_FALSE(cache.contains(game_state(rules, {{},{"4C"},{}})));
 }
+
+TEST(GlobalCache, TranspositionTableCommutativeTableauPiles) {
+    sol_rules rules;
+    rules.tableau_pile_count = 3;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{},{},{}});
+    transposition_table cache(gs, 1000);
+
+    ASSERT_TRUE (cache.insert  (game_state(rules, {{"6C","7D"},{"8C"},{"9D"}})).second);
+    ASSERT_FALSE(cache.insert  (game_state(rules, {{"8C"},{"6C","7D"},{"9D"}})).second);
+    ASSERT_TRUE (cache.contains(game_state(rules, {{"9D"},{"8C"},{"6C","7D"}})));
+    ASSERT_FALSE(cache.contains(game_state(rules, {{"8C"},{"6C","KD"},{"9D"}})));
+    ASSERT_EQ   (cache.size(), 1u);
+
+    cache.clear();
+    ASSERT_FALSE(cache.contains(game_state(rules, {{"6C","7D"},{"8C"},{"9D"}})));
+    ASSERT_EQ   (cache.size(), 0u);
+}
+
+TEST(GlobalCache, TranspositionTableGrowth) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+    transposition_table cache(gs, 100000);
+
+    std::vector<std::string> cards;
+    for (card::suit_t s = 0; s < 4; s++)
+        for (card::rank_t r = 1; r <= 13; r++)
+            cards.push_back(card(s, r).to_string());
+
+    // Enough distinct three card piles to force the table to grow
+    std::vector<game_state> states;
+    for (auto& a : cards) for (auto& b : cards) for (auto& c : cards) {
+        if (states.size() == 8000) break;
+        if (a == b || b == c || a == c) continue;
+        states.push_back(game_state(rules, {{a, b, c}}));
+    }
+
+    std::vector<state_cache::handle> handles;
+    for (auto& s : states) {
+        auto res = cache.insert(s);
+        ASSERT_TRUE(res.second);
+        handles.push_back(res.first);
+    }
+
+    ASSERT_GT(cache.bucket_count(), 1024u);
+    ASSERT_EQ(cache.size(), states.size());
+    for (auto& s : states) ASSERT_TRUE(cache.contains(s));
+
+    // Handles must still refer to their states after the table has grown
+    for (auto h : handles) cache.set_non_live(h, 1);
+    ASSERT_EQ(cache.get_states_removed_from_cache(), 0u);
+}
+
+TEST(GlobalCache, RunningHashCommutativeTableauPiles) {
+    sol_rules rules;
+    rules.tableau_pile_count = 3;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+
+    game_state a(rules, {{"6C","7D"},{"8C"},{"9D"}});
+    game_state b(rules, {{"8C"},{"9D"},{"6C","7D"}});
+    game_state c(rules, {{"7D","6C"},{"8C"},{"9D"}});
+    ASSERT_EQ(a.get_hash(), b.get_hash());
+    ASSERT_NE(a.get_hash(), c.get_hash());
+}
+
+TEST(GlobalCache, RunningHashRestoredByUndo) {
+    sol_rules rules;
+    rules.tableau_pile_count = 3;
+    rules.build_pol = sol_rules::build_policy::ANY_SUIT;
+
+    game_state gs(rules, {{"6C","7D"},{"8C"},{}});
+    uint64_t before = gs.get_hash();
+
+    std::vector<move> moves = gs.get_legal_moves();
+    ASSERT_FALSE(moves.empty());
+    for (move m : moves) {
+        gs.make_move(m);
+        ASSERT_NE(gs.get_hash(), before);
+        gs.undo_move(m);
+        ASSERT_EQ(gs.get_hash(), before);
+    }
+}
+
+TEST(GlobalCache, PackedKeyTwoDecks) {
+    sol_rules rules;
+    rules.tableau_pile_count = 2;
+    rules.two_decks = true;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{},{}});
+    lru_cache cache(gs, 1000);
+
+    // Every card of both decks in one pile, so the key is at its longest
+    std::vector<std::string> all_cards;
+    for (int deck = 0; deck < 2; deck++)
+        for (card::suit_t s = 0; s < 4; s++)
+            for (card::rank_t r = 1; r <= 13; r++)
+                all_cards.push_back(card(s, r).to_string());
+
+    game_state full(rules, string_il{{},{}});
+    for (auto& c : all_cards) full.place_card(0, card(c.c_str()));
+    game_state moved(full);
+    moved.place_card(1, moved.take_card(0));
+
+    ASSERT_TRUE (cache.insert(full).second);
+    ASSERT_FALSE(cache.insert(full).second);
+    ASSERT_FALSE(cache.contains(moved));
+    ASSERT_TRUE (cache.insert(moved).second);
+    ASSERT_EQ   (cache.size(), 2u);
+}
+
+TEST(GlobalCache, ClockEvictionSecondChance) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+    lru_cache cache(gs, 2, state_cache::eviction_policy::CLOCK);
+
+    game_state a(rules, {{"AC"}}), b(rules, {{"2C"}}), c(rules, {{"3C"}}), d(rules, {{"4C"}});
+
+    cache.set_non_live(cache.insert(a).first, 1);
+    cache.set_non_live(cache.insert(b).first, 1);
+
+    // Looking up 'a' gives it a second chance, so 'b' is evicted instead
+    ASSERT_FALSE(cache.insert(a).second);
+    auto c_handle = cache.insert(c).first;
+    ASSERT_TRUE (cache.contains(a));
+    ASSERT_FALSE(cache.contains(b));
+
+    // 'c' is live, so is skipped over
+    cache.insert(d);
+    ASSERT_FALSE(cache.contains(a));
+    ASSERT_TRUE (cache.contains(c));
+    ASSERT_TRUE (cache.contains(d));
+
+    // Everything left is live
+    ASSERT_THROW(cache.insert(b), std::runtime_error);
+    cache.set_non_live(c_handle, 1);
+
+    state_cache::eviction_stats stats = cache.get_eviction_stats();
+    ASSERT_EQ(stats.scans, 2u);
+    ASSERT_EQ(stats.max_scan_length, 2u);
+}
+
+TEST(GlobalCache, ByteBudgetEvicts) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+
+    const uint64_t budget = 4096;
+    lru_cache cache(gs, 1000000, state_cache::eviction_policy::LRU, budget);
+
+    for (card::suit_t s = 0; s < 4; s++) {
+        for (card::rank_t r = 1; r <= 13; r++) {
+            game_state state(rules, {{card(s, r).to_string()}});
+            cache.set_non_live(cache.insert(state).first, 1);
+            ASSERT_LE(cache.bytes_used(), budget);
+        }
+    }
+
+    ASSERT_GT(cache.get_states_removed_from_cache(), 0u);
+    ASSERT_LE(cache.peak_bytes_used(), budget);
+    ASSERT_EQ(cache.size() + cache.get_states_removed_from_cache(), 52u);
+}
+
+TEST(GlobalCache, SharedTranspositionTableDeduplicatesAcrossThreads) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+    shared_transposition_table cache(gs, 100000);
+
+    std::vector<std::string> cards;
+    for (card::suit_t s = 0; s < 4; s++)
+        for (card::rank_t r = 1; r <= 13; r++)
+            cards.push_back(card(s, r).to_string());
+
+    std::vector<game_state> states;
+    for (auto& a : cards) for (auto& b : cards) {
+        if (a != b) states.push_back(game_state(rules, {{a, b}}));
+    }
+
+    // Each thread inserts every state, in its own order. Each state must be
+    // new to exactly one of them
+    const int thread_count = 4;
+    std::atomic<uint64_t> new_states(0);
+    std::vector<std::vector<state_cache::handle>> handles(thread_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<const game_state*> order;
+            for (auto& s : states) order.push_back(&s);
+            std::shuffle(order.begin(), order.end(), std::mt19937(t));
+
+            for (auto s : order) {
+                auto res = cache.insert(*s);
+                if (res.second) {
+                    new_states++;
+                    handles[t].push_back(res.first);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    ASSERT_EQ(new_states.load(), states.size());
+    ASSERT_EQ(cache.size(), states.size());
+    for (auto& s : states) ASSERT_TRUE(cache.contains(s));
+
+    for (auto& hs : handles) for (auto h : hs) cache.set_non_live(h, 1);
+    ASSERT_EQ(cache.get_states_removed_from_cache(), 0u);
+}
+
+TEST(GlobalCache, ArenaReusesFreedBlocks) {
+    arena mem;
+
+    void* a = mem.allocate(40, 8);
+    void* b = mem.allocate(40, 8);
+    ASSERT_NE(a, b);
+
+    mem.deallocate(a, 40);
+    ASSERT_EQ(mem.allocate(40, 8), a);
+
+    // Blocks of other sizes don't reuse it
+    mem.deallocate(b, 40);
+    ASSERT_NE(mem.allocate(64, 8), b);
+
+    ASSERT_GT(mem.bytes_reserved(), 0u);
+    mem.release();
+    ASSERT_EQ(mem.bytes_reserved(), 0u);
+}
+
+TEST(GlobalCache, DeadStatesSurviveEviction) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+    lru_cache cache(gs, 4, state_cache::eviction_policy::LRU, 0, false, true);
+
+    std::vector<game_state> states;
+    for (card::rank_t r = 1; r <= 13; r++) {
+        states.push_back(game_state(rules, {{card(0, r).to_string()}}));
+    }
+    for (auto& s : states) cache.set_non_live(cache.insert(s).first, 1);
+
+    ASSERT_EQ(cache.size(), 4u);
+    ASSERT_EQ(cache.get_dead_state_count(), states.size() - 4);
+
+    // Evicted states are still known, so are not searched again
+    for (auto& s : states) {
+        ASSERT_TRUE(cache.contains(s));
+        ASSERT_FALSE(cache.insert(s).second);
+    }
+    ASSERT_EQ(cache.get_dead_state_hits(), states.size() - 4);
+}
+
+TEST(GlobalCache, CostEvictionKeepsExpensiveSubtrees) {
+    sol_rules rules;
+    rules.tableau_pile_count = 1;
+    rules.build_pol = sol_rules::build_policy::SAME_SUIT;
+    game_state gs(rules, string_il{{}});
+    lru_cache cache(gs, 4, state_cache::eviction_policy::COST);
+
+    game_state expensive(rules, {{"AS"}});
+    cache.set_non_live(cache.insert(expensive).first, 1000);
+
+    for (card::rank_t r = 1; r <= 13; r++) {
+        game_state cheap(rules, {{card(0, r).to_string()}});
+        cache.set_non_live(cache.insert(cheap).first, 1);
+    }
+
+    ASSERT_TRUE(cache.contains(expensive));
+    ASSERT_EQ(cache.size(), 4u);
+}
@@ -27,6 +27,7 @@
 #include "../../main/game/search-state/game_state.h"
 #include "../../main/game/sol_rules.h"
 #include "../../main/game/move.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
 
 typedef sol_rules::build_policy pol;
 typedef sol_rules::spaces_policy s_pol;
@@ -343,3 +344,91 @@ TEST(LegalMoveGen, StockDealToTableau) {
 
     ASSERT_TRUE(test_helper::moves_eq(exp_moves, actual_moves)) << actual_moves;
 }
+
+TEST(LegalMoveGen, PresetEngines) {
+    auto engine_of = [](const std::string& preset) {
+        return game_state(rules_parser::from_preset(preset), 1, game_state::streamliner_options::NONE).get_engine();
+    };
+
+    ASSERT_EQ(engine_of("klondike"), game_state::engine::KLONDIKE);
+    ASSERT_EQ(engine_of("free-cell"), game_state::engine::FREE_CELL);
+    ASSERT_EQ(engine_of("bakers-game"), game_state::engine::FREE_CELL);
+    ASSERT_EQ(engine_of("canfield"), game_state::engine::CANFIELD);
+    ASSERT_EQ(engine_of("spider"), game_state::engine::SPIDER);
+    ASSERT_EQ(engine_of("spiderette"), game_state::engine::SPIDER);
+    ASSERT_EQ(engine_of("black-hole"), game_state::engine::BLACK_HOLE);
+    ASSERT_EQ(engine_of("accordion"), game_state::engine::GENERIC);
+}
+
+TEST(LegalMoveGen, CustomRulesEngine) {
+    // Rules the move generator doesn't ask about don't change the engine
+    sol_rules sr = rules_parser::from_preset("klondike");
+    sr.build_pol = pol::SAME_SUIT;
+    ASSERT_EQ(game_state(sr, 1, game_state::streamliner_options::NONE).get_engine(),
+              game_state::engine::KLONDIKE);
+
+    // But any it does, does
+    sr.cells = 1;
+    ASSERT_EQ(game_state(sr, 1, game_state::streamliner_options::NONE).get_engine(),
+              game_state::engine::GENERIC);
+}
+
+TEST(LegalMoveGen, StagedMovesMatchEagerMoves) {
+    const move sentinel(move::mtype::null);
+
+    for (auto preset : {"klondike", "free-cell", "canfield", "spider", "black-hole", "golf",
+                        "gaps-basic-variant", "accordion", "alpha-star", "simple-simon"}) {
+        game_state gs(rules_parser::from_preset(preset), 1, game_state::streamliner_options::NONE);
+
+        test_helper::random_walk(gs, 200, 1, [&](game_state& state, move parent) {
+            vector<move> eager_moves = state.get_legal_moves(parent);
+
+            // Each stage is appended after the moves already on the stack,
+            // as the solver generates them
+            vector<move> staged_moves = {sentinel};
+            for (auto s = game_state::move_stage::FOUNDATION; s != game_state::move_stage::NONE;
+                 s = game_state::next_move_stage(s))
+                state.get_legal_moves(staged_moves, parent, s);
+
+            ASSERT_EQ(staged_moves.front(), sentinel) << preset;
+            staged_moves.erase(begin(staged_moves));
+            ASSERT_TRUE(test_helper::moves_eq(eager_moves, staged_moves)) << preset << "\n" << staged_moves;
+        });
+    }
+}
+
+TEST(LegalMoveGen, CardRelationsMatchPolicies) {
+    typedef sol_rules::accordion_policy acc_pol;
+    const std::vector<std::vector<acc_pol>> accordion_pols = {
+            {acc_pol::SAME_RANK}, {acc_pol::SAME_SUIT}, {acc_pol::RED_BLACK}, {acc_pol::ANY_SUIT},
+            {acc_pol::SAME_RANK, acc_pol::SAME_SUIT}, {acc_pol::SAME_RANK, acc_pol::RED_BLACK}, {}
+    };
+    size_t acc_idx = 0;
+
+    for (auto p : {pol::NO_BUILD, pol::SAME_SUIT, pol::RED_BLACK, pol::ANY_SUIT}) {
+        for (auto other_p : {pol::NO_BUILD, pol::SAME_SUIT, pol::RED_BLACK, pol::ANY_SUIT}) {
+            sol_rules sr = rules_parser::from_preset("klondike");
+            sr.build_pol = p;
+            sr.built_group_pol = other_p;
+            sr.sequence_build_pol = p;
+            sr.accordion_pol = accordion_pols[acc_idx++ % accordion_pols.size()];
+
+            test_helper::check_card_relations(game_state(sr, 1, game_state::streamliner_options::NONE));
+        }
+    }
+}
+
+TEST(LegalMoveGen, TopCardIndexMatchesPairwiseChecks) {
+    for (auto preset : {"klondike", "free-cell", "canfield", "spider", "alpha-star", "simple-simon",
+                        "seahaven-towers", "fan", "king-albert", "east-haven"}) {
+        for (uint seed = 1; seed <= 3; seed++) {
+            game_state gs(rules_parser::from_preset(preset), seed, game_state::streamliner_options::NONE);
+
+            test_helper::random_walk(gs, 200, seed, [&](game_state& state, move parent) {
+                // Same moves, in the same order
+                ASSERT_EQ(test_helper::pairwise_legal_moves(state, parent), state.get_legal_moves(parent))
+                        << preset << "\n" << state;
+            });
+        }
+    }
+}
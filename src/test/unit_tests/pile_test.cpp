@@ -26,6 +26,41 @@
 #include "../test_helper.h"
 #include "../../main/game/pile.h"
 
+#include <random>
+
+// The built groups of these tests are same suit runs of face-up cards
+static bool extends(const card below, const card c) {
+    return !below.is_face_down()
+           && below.get_suit() == c.get_suit()
+           && below.get_rank() == c.get_rank() + 1;
+}
+
+// Re-evaluates the runs from the given index to the top of the pile, as the
+// game state does after setting a card
+static void set_card(pile& p, pile::size_type idx, const card c) {
+    p.set(idx, c, idx + 1 < p.size() && extends(p[idx + 1], c));
+    for (auto i = idx; i-- > 0;)
+        p.set(i, p[i], extends(p[i + 1], p[i]));
+}
+
+// Checks the derived data against a scan of the pile
+static void expect_derived_data(const pile& p) {
+    pile::size_type face_down = 0;
+    for (pile::size_type i = 0; i < p.size(); i++) face_down += p[i].is_face_down();
+    EXPECT_EQ(face_down, p.face_down_count());
+
+    if (p.empty()) return;
+
+    pile::size_type height = 1;
+    while (height < p.size() && extends(p[height], p[height - 1])) height++;
+    EXPECT_EQ(height, p.built_group_height());
+
+    bool ordered = p.size() == 13;
+    for (pile::size_type i = 0; ordered && i < p.size(); i++)
+        ordered = p[i].get_suit() == p[0].get_suit() && p[i].get_rank() == i + 1;
+    EXPECT_EQ(ordered, p.is_ordered(13));
+}
+
 TEST(Pile, Size) {
     pile p = {};
     ASSERT_EQ(0, p.size());
@@ -74,6 +109,14 @@ TEST(Pile, Place) {
     ASSERT_EQ(p, t3);
 }
 
+TEST(Pile, PlaceBeyondCapacity) {
+    pile p = {};
+    for (pile::size_type i = 0; i < pile::capacity; i++) p.place("AS");
+    ASSERT_THROW(p.place("AS"), std::runtime_error);
+    ASSERT_EQ(pile::capacity, p.size());
+    ASSERT_THROW(p.set(pile::capacity, "KC"), std::out_of_range);
+}
+
 TEST(Pile, Take) {
     pile t1 = {};
     pile t2 = {"AS"};
@@ -104,3 +147,84 @@ TEST(Pile, CompOperators) {
     ASSERT_LT(p1, p4);
     ASSERT_EQ(p4, p4);
 }
+
+TEST(Pile, CompOperatorsLongPiles) {
+    // Differ only above the cards kept in the order key
+    pile p1 = {"KS", "QS", "JS", "10S", "9S", "8S", "7S", "6S", "5S", "4S", "2C"};
+    pile p2 = {"KS", "QS", "JS", "10S", "9S", "8S", "7S", "6S", "5S", "4S", "3C"};
+
+    ASSERT_LT(p1, p2);
+    ASSERT_GT(p2, p1);
+    ASSERT_LE(p1, p1);
+    ASSERT_GE(p2, p2);
+
+    p2.take();
+    p2.place("2C");
+    ASSERT_LE(p1, p2);
+    ASSERT_GE(p1, p2);
+
+    p1.take();
+    ASSERT_LT(p1, p2);
+    p1.place("AC");
+    ASSERT_LT(p1, p2);
+
+    p1.set(10, "AC");
+    ASSERT_LT(p1, p2);
+}
+
+TEST(Pile, DerivedDataFollowsChanges) {
+    std::mt19937 rng(1);
+    pile p = {};
+
+    for (int i = 0; i < 2000; i++) {
+        int op = rng() % 4;
+        if (op == 0 && !p.empty()) {
+            p.take();
+        } else if (op == 1 && !p.empty()) {
+            auto idx = pile::size_type(rng() % p.size());
+            set_card(p, idx, card(card::suit_t(rng() % 4), card::rank_t(rng() % 13 + 1), rng() % 3 == 0));
+        } else if (p.size() < 40) {
+            // Mostly builds on the top card, so that long built groups form
+            card c(card::suit_t(rng() % 4), card::rank_t(rng() % 13 + 1), rng() % 4 == 0);
+            if (!p.empty() && p.top_card().get_rank() > 1 && rng() % 2 == 0)
+                c = card(p.top_card().get_suit(), card::rank_t(p.top_card().get_rank() - 1));
+            p.place(c, !p.empty() && extends(p.top_card(), c));
+        }
+        expect_derived_data(p);
+    }
+}
+
+TEST(Pile, OrderedSuit) {
+    pile p = {};
+    for (card::rank_t r = 13; r > 0; r--) {
+        p.place(card(card::suit::Hearts, r), !p.empty() && extends(p.top_card(), card(card::suit::Hearts, r)));
+        expect_derived_data(p);
+    }
+    ASSERT_TRUE(p.is_ordered(13));
+    ASSERT_EQ(13, p.built_group_height());
+
+    p.take();
+    expect_derived_data(p);
+    ASSERT_FALSE(p.is_ordered(13));
+    p.place(card(card::suit::Hearts, 1), true);
+    ASSERT_TRUE(p.is_ordered(13));
+
+    // Turning a card in the middle face down breaks the built group above it,
+    // but not the order of the suit
+    set_card(p, 5, card(card::suit::Hearts, 6, true));
+    expect_derived_data(p);
+    ASSERT_EQ(1, p.face_down_count());
+    ASSERT_EQ(5, p.built_group_height());
+    ASSERT_TRUE(p.is_ordered(13));
+
+    set_card(p, 5, card(card::suit::Clubs, 6));
+    expect_derived_data(p);
+    ASSERT_EQ(0, p.face_down_count());
+    ASSERT_EQ(5, p.built_group_height());
+    ASSERT_FALSE(p.is_ordered(13));
+
+    set_card(p, 5, card(card::suit::Hearts, 6));
+    expect_derived_data(p);
+    ASSERT_EQ(13, p.built_group_height());
+    ASSERT_TRUE(p.is_ordered(13));
+}
@@ -0,0 +1,214 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "../../main/solver/portfolio.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+#include "../../main/input-output/input/json-parsing/json_helper.h"
+
+using std::vector;
+using boost::none;
+using rapidjson::Document;
+
+typedef game_state::streamliner_options sos;
+typedef solver::result::type rt;
+
+static portfolio::dealer seed_dealer(const sol_rules& rules, int seed) {
+    return [&rules, seed](sos str_opts) { return game_state(rules, seed, str_opts); };
+}
+
+// Tries to help the portfolio's run from another thread until it has helped,
+// or the run is over
+static std::thread helper(const portfolio& p, const std::atomic<bool>& done, std::atomic<bool>& helped) {
+    return std::thread([&p, &done, &helped] {
+        while (!done && !helped) {
+            helped = p.help();
+            std::this_thread::yield();
+        }
+    });
+}
+
+// Helpers can only join searches of the shared transposition table
+static cache_options shared_cache(uint64_t memory = 0) {
+    return cache_options(100000, state_cache::backend::SHARED_TRANSPOSITION_TABLE,
+                         state_cache::eviction_policy::LRU, memory);
+}
+
+static bool solves(game_state gs, const vector<move>& solution) {
+    for (const move& m : solution) gs.make_move(m);
+    return gs.is_solved();
+}
+
+TEST(Portfolio, SingleConfig) {
+    const sol_rules rules = rules_parser::from_preset("black-hole");
+    portfolio p({{sos::NONE, none}}, cache_options(100000));
+    search_budget budget;
+    portfolio::outcome out = p.run(seed_dealer(rules, 3), budget);
+
+    // The same search as solving the deal directly
+    solver sol(game_state(rules, 3, sos::NONE), cache_options(100000));
+    solver::result exp = sol.run();
+    ASSERT_EQ(out.chosen, 0u);
+    ASSERT_EQ(out.answer().res.sol_type, exp.sol_type);
+    ASSERT_EQ(out.answer().res.states_searched, exp.states_searched);
+    ASSERT_EQ(out.answer().solution, sol.get_solution());
+}
+
+TEST(Portfolio, StreamlinerSolutionCancelsTheRest) {
+    // The streamliners solve this deal in a few thousand states, and the
+    // search without them takes over a million
+    const sol_rules rules = rules_parser::from_preset("free-cell");
+    portfolio p({{sos::BOTH, none}, {sos::NONE, none}}, cache_options(100000));
+    search_budget budget;
+    portfolio::outcome out = p.run(seed_dealer(rules, 18), budget);
+
+    ASSERT_EQ(out.chosen, 0u);
+    ASSERT_EQ(out.answer().res.sol_type, rt::SOLVED);
+    ASSERT_FALSE(out.answer().solution.empty());
+    ASSERT_EQ(out.attempts[1].res.sol_type, rt::TERMINATED);
+}
+
+TEST(Portfolio, SearchesShareTheCacheBudget) {
+    const uint64_t memory = 512 * 1024;
+    const cache_options opts(100000, state_cache::backend::LRU, state_cache::eviction_policy::LRU, memory);
+    const cache_options share = portfolio::share_of(opts, 2);
+    ASSERT_EQ(share.capacity, 50000u);
+    ASSERT_EQ(share.memory, memory / 2);
+    ASSERT_EQ(portfolio::share_of(cache_options(100000), 2).memory, 0u);
+
+    const sol_rules rules = rules_parser::from_preset("free-cell");
+    portfolio p({{sos::BOTH, none}, {sos::NONE, none}}, opts);
+    search_budget budget;
+    portfolio::outcome out = p.run(seed_dealer(rules, 18), budget);
+    ASSERT_EQ(out.answer().res.sol_type, rt::SOLVED);
+    ASSERT_LE(out.attempts[0].res.peak_cache_bytes + out.attempts[1].res.peak_cache_bytes, memory);
+}
+
+TEST(Portfolio, OnlySoundSearchesProveUnsolvable) {
+    const sol_rules rules = rules_parser::from_preset("-test-free-cell");
+    const Document deal = json_helper::get_file_json("resources/free_cell/SimpleUnsolvable.json");
+    portfolio p(portfolio::for_streamliners(command_line_helper::streamliner_opt::SMART, std::chrono::milliseconds(60000)),
+                cache_options(100000));
+    search_budget budget;
+    portfolio::outcome out = p.run([&](sos str_opts) { return game_state(rules, deal, str_opts); }, budget);
+
+    ASSERT_EQ(out.chosen, 1u);
+    ASSERT_EQ(out.answer().res.sol_type, rt::UNSOLVABLE);
+}
+
+TEST(Portfolio, NoConclusiveAnswer) {
+    const sol_rules rules = rules_parser::from_preset("spider");
+    portfolio p({{sos::BOTH, none}, {sos::NONE, none}}, cache_options(100000));
+
+    // Takes the sound search's result
+    search_budget budget;
+    budget.cancel();
+    portfolio::outcome out = p.run(seed_dealer(rules, 3), budget);
+    ASSERT_EQ(out.chosen, 1u);
+    ASSERT_EQ(out.attempts[0].res.sol_type, rt::TERMINATED);
+    ASSERT_EQ(out.attempts[1].res.sol_type, rt::TERMINATED);
+
+    // A streamlined search can give up early without stopping the others
+    portfolio timed({{sos::BOTH, std::chrono::milliseconds(0)}, {sos::NONE, none}}, cache_options(100000));
+    search_budget states;
+    states.set_state_limit(2000);
+    out = timed.run(seed_dealer(rules, 3), states);
+    ASSERT_EQ(out.chosen, 1u);
+    ASSERT_EQ(out.attempts[0].res.sol_type, rt::TIMEOUT);
+    ASSERT_EQ(out.attempts[0].res.states_searched, 0u);
+    ASSERT_GE(out.attempts[1].res.states_searched, 2000u);
+}
+
+TEST(Portfolio, HelpersJoinTheSearch) {
+    const sol_rules rules = rules_parser::from_preset("spider");
+    const uint64_t memory = 256 * 1024;
+    portfolio p({{sos::BOTH, std::chrono::milliseconds(0)}, {sos::NONE, none}}, shared_cache(memory), 1, 1);
+    ASSERT_FALSE(p.help());
+
+    std::atomic<bool> done(false), helped(false);
+    std::thread t = helper(p, done, helped);
+    search_budget budget;
+    budget.set_state_limit(2000);
+    portfolio::outcome out = p.run(seed_dealer(rules, 1), budget);
+    done = true;
+    t.join();
+
+    // The helper's states count towards the search it joined, and it shares
+    // that search's cache, so the search keeps to its memory
+    ASSERT_TRUE(helped);
+    ASSERT_EQ(out.attempts[1].res.sol_type, rt::TIMEOUT);
+    ASSERT_EQ(budget.get_states_spent(), out.attempts[0].res.states_searched + out.attempts[1].res.states_searched);
+    ASSERT_LE(out.attempts[1].res.peak_cache_bytes, memory);
+    ASSERT_FALSE(p.help());
+}
+
+TEST(Portfolio, HelpersRaceOtherStreamliners) {
+    // Without a shared cache the helper can't join the search, so it races the
+    // streamliners the configs don't use, which solve this deal far sooner
+    const sol_rules rules = rules_parser::from_preset("free-cell");
+    portfolio p({{sos::NONE, none}}, cache_options(100000), 1, 1);
+
+    std::atomic<bool> done(false), helped(false);
+    std::thread t = helper(p, done, helped);
+    search_budget budget;
+    budget.set_state_limit(500000);
+    portfolio::outcome out = p.run(seed_dealer(rules, 18), budget);
+    done = true;
+    t.join();
+
+    ASSERT_TRUE(helped);
+    ASSERT_EQ(out.chosen, 1u);
+    ASSERT_EQ(out.alternatives[0].res.sol_type, rt::SOLVED);
+    ASSERT_TRUE(solves(out.answer().init_state, out.answer().solution));
+    ASSERT_EQ(out.attempts[0].res.sol_type, rt::TERMINATED);
+    ASSERT_FALSE(p.help());
+}
+
+TEST(Portfolio, HelpersKeepTheAnswer) {
+    const sol_rules fc_rules = rules_parser::from_preset("free-cell");
+    portfolio solvable({{sos::BOTH, none}}, shared_cache(), 1, 2);
+    std::atomic<bool> done(false), helped(false);
+    std::thread t = helper(solvable, done, helped);
+    search_budget budget;
+    portfolio::outcome out = solvable.run(seed_dealer(fc_rules, 18), budget);
+    done = true;
+    t.join();
+
+    ASSERT_EQ(out.answer().res.sol_type, rt::SOLVED);
+    ASSERT_TRUE(solves(out.answer().init_state, out.answer().solution));
+
+    // Only once every helper has run out of work is the deal unsolvable
+    const sol_rules test_rules = rules_parser::from_preset("-test-free-cell");
+    const Document deal = json_helper::get_file_json("resources/free_cell/SimpleUnsolvable.json");
+    portfolio unsolvable({{sos::NONE, none}}, shared_cache(), 2, 2);
+    done = false;
+    helped = false;
+    t = helper(unsolvable, done, helped);
+    out = unsolvable.run([&](sos str_opts) { return game_state(test_rules, deal, str_opts); }, budget);
+    done = true;
+    t.join();
+
+    ASSERT_EQ(out.answer().res.sol_type, rt::UNSOLVABLE);
+}
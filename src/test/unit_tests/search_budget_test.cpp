@@ -0,0 +1,98 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "../../main/solver/solver.h"
+#include "../../main/solver/search_budget.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+
+typedef solver::result::type rt;
+
+// A deal that takes far longer than the tests to solve
+static game_state slow_deal() {
+    return game_state(rules_parser::from_preset("spider"), 1, game_state::streamliner_options::NONE);
+}
+
+TEST(SearchBudget, StateLimit) {
+    for (uint threads : {1u, 3u}) {
+        solver sol(slow_deal(), cache_options(100000), threads);
+        search_budget budget;
+        budget.set_state_limit(1000);
+
+        solver::result res = sol.run(budget);
+        ASSERT_EQ(res.sol_type, rt::TIMEOUT);
+        // Every state is drawn from the budget, but the limit is only looked
+        // at every few hundred states
+        ASSERT_EQ(budget.get_states_spent(), res.states_searched);
+        ASSERT_GE(res.states_searched, 1000u);
+        ASSERT_LT(res.states_searched, 1000u + threads * 256);
+    }
+}
+
+TEST(SearchBudget, SharedBySolvers) {
+    search_budget budget;
+    budget.set_state_limit(1000);
+
+    solver first(slow_deal(), cache_options(100000));
+    ASSERT_EQ(first.run(budget).sol_type, rt::TIMEOUT);
+
+    // Nothing is left for the second
+    solver second(slow_deal(), cache_options(100000));
+    solver::result res = second.run(budget);
+    ASSERT_EQ(res.sol_type, rt::TIMEOUT);
+    ASSERT_EQ(res.states_searched, 0u);
+}
+
+TEST(SearchBudget, Cancelled) {
+    search_budget budget;
+    budget.cancel();
+    solver sol(slow_deal(), cache_options(100000));
+    solver::result res = sol.run(budget);
+    ASSERT_EQ(res.sol_type, rt::TERMINATED);
+    ASSERT_EQ(res.states_searched, 0u);
+
+    // Through a parent, with several threads
+    search_budget parent;
+    search_budget child(boost::none, &parent);
+    parent.cancel();
+    ASSERT_TRUE(child.is_cancelled());
+    solver par_sol(slow_deal(), cache_options(100000), 2);
+    ASSERT_EQ(par_sol.run(child).sol_type, rt::TERMINATED);
+}
+
+TEST(SearchBudget, DeadlineAndMemory) {
+    search_budget timed(std::chrono::milliseconds(0));
+    solver timed_sol(slow_deal(), cache_options(100000));
+    ASSERT_EQ(timed_sol.run(timed).sol_type, rt::TIMEOUT);
+
+    // The parent's deadline binds the child
+    search_budget parent(std::chrono::milliseconds(0));
+    search_budget child(boost::none, &parent);
+    solver child_sol(slow_deal(), cache_options(100000));
+    ASSERT_EQ(child_sol.run(child).sol_type, rt::TIMEOUT);
+
+    search_budget small;
+    small.set_memory_limit(1);
+    solver mem_sol(slow_deal(), cache_options(100000));
+    ASSERT_EQ(mem_sol.run(small).sol_type, rt::MEM_LIMIT);
+}
@@ -0,0 +1,171 @@
+/*
+  Solvitaire: a solver for perfect information solitaire games
+  Copyright (C) 2018 Charles Blake <thecharlesblake@live.co.uk> and
+  Ian Gent <Ian.Gent@st-andrews.ac.uk>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program (see LICENSE file); if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../../main/server/solver_server.h"
+#include "../../main/input-output/input/json-parsing/rules_parser.h"
+
+using std::string;
+using boost::none;
+using rapidjson::Document;
+
+typedef command_line_helper::streamliner_opt sos;
+
+static Document parse(const string& s) {
+    Document d;
+    d.Parse(s.c_str());
+    EXPECT_FALSE(d.HasParseError()) << s;
+    return d;
+}
+
+TEST(SolverServer, SolvesSeed) {
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    Document res = parse(server.respond(R"({"id": "a", "type": "black-hole", "seed": 3})"));
+
+    // The same search as solving the deal directly
+    game_state gs(rules_parser::from_preset("black-hole"), 3, game_state::streamliner_options::NONE);
+    solver sol(gs, cache_options(100000));
+    solver::result exp = sol.run();
+
+    ASSERT_STREQ(res["id"].GetString(), "a");
+    ASSERT_EQ(res["seed"].GetInt(), 3);
+    ASSERT_EQ(res["states searched"].GetUint64(), exp.states_searched);
+    ASSERT_STREQ(res["outcome"].GetString(), exp.sol_type == solver::result::type::SOLVED ? "solved" : "unsolvable");
+}
+
+TEST(SolverServer, DefaultRules) {
+    solver_server server(rules_parser::from_preset("black-hole"), cache_options(100000), 1, 60000, sos::NONE);
+    Document res = parse(server.respond(R"({"seed": 3})"));
+    Document exp = parse(server.respond(R"({"type": "black-hole", "seed": 3})"));
+
+    ASSERT_EQ(res["states searched"].GetUint64(), exp["states searched"].GetUint64());
+}
+
+TEST(SolverServer, Errors) {
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+
+    for (const char* req : {"not json",
+                            R"({"id": 1, "seed": 3})",
+                            R"({"id": 1, "type": "no-such-game", "seed": 3})",
+                            R"({"id": 1, "type": "black-hole"})",
+                            R"({"id": 1, "type": "black-hole", "seed": 3, "streamliners": "all"})"}) {
+        Document res = parse(server.respond(req));
+        ASSERT_TRUE(res.HasMember("error")) << req;
+        ASSERT_FALSE(res.HasMember("outcome")) << req;
+    }
+}
+
+TEST(SolverServer, ServesLines) {
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    std::istringstream in("{\"id\": 1, \"type\": \"black-hole\", \"seed\": 3}\n"
+                          "\n"
+                          "{\"id\": 2, \"type\": \"black-hole\", \"seed\": 3}\n");
+    std::ostringstream out;
+    server.serve(in, out);
+
+    std::istringstream lines(out.str());
+    string line;
+    for (int id = 1; id <= 2; id++) {
+        ASSERT_TRUE(std::getline(lines, line));
+        ASSERT_EQ(parse(line)["id"].GetInt(), id);
+    }
+    ASSERT_FALSE(std::getline(lines, line));
+}
+
+TEST(SolverServer, ServesAfterMalformedCards) {
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    std::istringstream in(
+            "{\"id\": 1, \"type\": \"-test-free-cell\", \"deal\": {\"tableau piles\": [[\"ZZ\"], [], [], []]}}\n"
+            "{\"id\": 2, \"type\": \"-test-free-cell\", \"deal\": {\"tableau piles\": [[\"9C\"], [], [], []]}}\n"
+            "{\"id\": 3, \"type\": \"black-hole\", \"seed\": 3}\n");
+    std::ostringstream out;
+    server.serve(in, out);
+
+    std::istringstream lines(out.str());
+    string line;
+    for (int id = 1; id <= 3; id++) {
+        ASSERT_TRUE(std::getline(lines, line));
+        Document res = parse(line);
+        ASSERT_EQ(res["id"].GetInt(), id);
+        ASSERT_EQ(res.HasMember("error"), id < 3) << line;
+    }
+    ASSERT_FALSE(std::getline(lines, line));
+}
+
+TEST(SolverServer, Stops) {
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    server.stop();
+    std::istringstream in("{\"id\": 1, \"type\": \"black-hole\", \"seed\": 3}\n");
+    std::ostringstream out;
+    server.serve(in, out);
+    ASSERT_TRUE(out.str().empty());
+}
+
+TEST(SolverServer, ServesSocketUntilStopped) {
+    const string path = "/tmp/solvitaire-test-" + std::to_string(getpid()) + ".sock";
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    bool served = false;
+    std::thread t([&] { served = server.serve_socket(path, 2); });
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    while (connect(conn, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) std::this_thread::yield();
+
+    const string req = "{\"id\": 1, \"type\": \"black-hole\", \"seed\": 3}\n";
+    ASSERT_EQ(write(conn, req.data(), req.size()), ssize_t(req.size()));
+    string res;
+    char c;
+    while (read(conn, &c, 1) == 1 && c != '\n') res += c;
+    ASSERT_EQ(parse(res)["id"].GetInt(), 1);
+
+    // Stops with the connection still open, and removes its socket
+    server.stop();
+    t.join();
+    close(conn);
+    ASSERT_TRUE(served);
+    struct stat st;
+    ASSERT_NE(stat(path.c_str(), &st), 0);
+}
+
+TEST(SolverServer, KeepsFilesInTheSocketsPlace) {
+    const string path = "/tmp/solvitaire-test-" + std::to_string(getpid()) + ".txt";
+    FILE* f = fopen(path.c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fclose(f);
+
+    solver_server server(none, cache_options(100000), 1, 60000, sos::NONE);
+    ASSERT_FALSE(server.serve_socket(path, 1));
+    struct stat st;
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    ASSERT_TRUE(S_ISREG(st.st_mode));
+    unlink(path.c_str());
+}